@@ -119,13 +119,15 @@ const int c;
 
 void autodoc_comment() { }
 
-void autodoc_header(firstpage, input_files, grouped, name, terse, section)
+void autodoc_header(firstpage, input_files, grouped, name, terse, section,
+									date)
 ManualPage *firstpage;
 int input_files;
 boolean grouped;
 const char *name;
 const char *terse;
 const char *section;
+Time_t date;
 {
     const char *basename = strrchr(firstpage->sourcefile, '/');
     int len;
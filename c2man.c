@@ -12,6 +12,17 @@
 #include "strappend.h"
 #include "manpage.h"
 #include "output.h"
+#include "depend.h"
+#include "cache.h"
+#include "manifest.h"
+#include "inputs.h"
+#include "server.h"
+#include "watch.h"
+#include "stats.h"
+#include "trace.h"
+#include "nocpp.h"
+#include "catalog.h"
+#include "snapshot.h"
 #include "patchlevel.h"
 
 #ifdef I_FCNTL
@@ -25,6 +36,11 @@
 #include <sys/stat.h>
 #include <signal.h>
 
+#ifdef HAS_FORK
+#include <sys/wait.h>
+#include "serial.h"
+#endif
+
 /* getopt declarations */
 extern int getopt();
 extern char *optarg;
@@ -103,6 +119,55 @@ boolean always_document_params = TRUE;
 /* look for a function def comment at the start of the function body */
 boolean look_at_body_start = FALSE;
 
+/* number of input files to parse at once, in separate worker processes */
+int max_jobs = 1;
+
+/* number of input files to run the preprocessor on ahead of the parser */
+int cpp_lookahead = 0;
+
+/* number of input files to give the preprocessor at once */
+int max_batch = 1;
+
+/* directory to cache the preprocessor's output in between runs */
+char *cache_dir = NULL;
+
+/* keep a manifest in the output directory, to skip unchanged input files */
+boolean use_manifest = FALSE;
+
+/* only replace output files whose contents change */
+boolean write_if_changed = FALSE;
+
+/* write a make rule for each input file, giving what its pages depend on */
+boolean write_make_rules = FALSE;
+
+/* look through directories given as input for the files in them */
+boolean recurse_dirs = FALSE;
+
+/* run again whenever the input files change */
+static boolean watch_changes = FALSE;
+
+/* report what's undocumented instead of writing pages, and the percentage of
+ * everything that must be documented for the run to succeed.
+ */
+boolean check_coverage = FALSE;
+static int coverage_threshold = 0;
+
+/* drop the declarations outside the base file that define no types before
+ * they're parsed; -K turns it off, to check that it makes no difference.
+ */
+boolean skim_declarations = TRUE;
+
+/* the date to put on the pages, from -E or SOURCE_DATE_EPOCH */
+boolean date_given = FALSE;
+Time_t given_date;
+boolean clamp_date = FALSE;
+
+/* where to write a trace of the run, if anywhere */
+static const char *trace_name = NULL;
+
+/* should we note the files the preprocessor reads for each input file? */
+static boolean note_dependencies = FALSE;
+
 /* only look for a function def comment at the start of the function body */
 boolean body_start_only = FALSE;
 
@@ -155,6 +220,21 @@ struct Output *output = &nroff_output;
 const char *default_section = "3";
 #endif
 
+/* an output format asked for with -T; the pages are written in each in turn */
+typedef struct OutputFormat
+{
+    struct Output *output;
+    const char *default_section;
+    char *dir;			/* output directory, if not that of -o */
+    const char *section;	/* manual section, if not that of -S */
+} OutputFormat;
+
+/* one for each of the backends should be plenty */
+#define MAX_FORMATS	8
+
+static OutputFormat formats[MAX_FORMATS];
+static int num_formats = 0;
+
 /* should we generate the output file named after the input file? */
 boolean use_input_name = FALSE;
 
@@ -176,6 +256,28 @@ const char *cpp_cmd = CPP_FILE_COM;
 #endif
 #endif
 
+#if defined(USE_CPP) && defined(HAS_FORK) && defined(HAS_WAITPID)
+#define SPAWN_CPP	/* run the preprocessor ourselves, not via the shell */
+#endif
+
+#ifdef SPAWN_CPP
+/* an argument vector being built up */
+typedef struct ArgList
+{
+    char **argv;
+    int argc, size;
+} ArgList;
+
+/* the preprocessor command split into words, followed by its options */
+static ArgList cpp_args;
+
+/* the preprocessor options, as given on the command line */
+static ArgList cpp_opt_args;
+
+/* process id of the preprocessor we're reading from */
+static int cpp_pid;
+#endif
+
 boolean verbose = FALSE;
 
 /* can cpp read standard input? */
@@ -320,11 +422,56 @@ usage ()
 #endif
 					fputs("file, none or remove\n", stderr);
     fputs(" -n\t\tName output file after input source file\n", stderr);
+    fputs(" -a count\tpreprocess up to count input files together\n", stderr);
+    fputs(" -C directory\tcache preprocessor output in directory\n", stderr);
+    fputs(" -m\t\tonly redo input files changed since the last run\n",
+									stderr);
+    fputs(" -u\t\tonly replace output files whose contents change\n",
+									stderr);
+    fputs(" -d\t\twrite make dependencies for each input file\n", stderr);
+    fputs(" -R\t\tprocess the files in directories, and those below\n",
+									stderr);
+    fputs(" -f pattern\tonly take files matching pattern from directories\n",
+									stderr);
+    fputs(" -X pattern\tskip files and directories matching pattern\n",
+									stderr);
+    fputs(" @file\t\tread input file names from file, or - for stdin\n",
+									stderr);
+    fputs(" -w\t\tregenerate the pages whenever the input files change\n",
+									stderr);
+    fputs(" -z text|json[:file]\treport the time spent in each phase, and counts\n",
+									stderr);
+    fputs(" -t file\twrite a trace of the run to file, for a trace viewer\n",
+									stderr);
+    fputs(" -E date\tdate every page with date, as seconds or yyyy-mm-dd\n",
+									stderr);
+    fputs(" -N auto|always|never\tread input files without the preprocessor\n",
+									stderr);
+    fputs(" -q\t\tskip system headers when reading files directly\n", stderr);
+    fputs(" -Q file\tlikewise, adding the type names in file to those known\n",
+									stderr);
+    fputs(" -c percent\treport what's undocumented instead, failing below percent\n",
+									stderr);
+    fputs(" -K\t\tparse declarations outside the input files in full\n",
+									stderr);
+#ifdef USE_SERVER
+    fputs(" -Y socket\trun jobs for clients on socket (must come first)\n",
+									stderr);
+    fputs(" -y socket\thave server on socket do the job (must come first)\n",
+									stderr);
+#endif
+#ifdef HAS_FORK
+    fputs(" -j jobs\tparse up to jobs input files at once\n", stderr);
+    fputs(" -J depth\tpreprocess up to depth files ahead of the parser\n",
+									stderr);
+#endif
     fputs(" -L\t\tLazy: Be silent about undocumented parameters\n",
                                                                     stderr);
 
     fputs(" -T n|l|h|t|a[,options]\tselect typesetting output format: nroff, LaTeX, HTML ,TeXinfo or AutoDoc\n",
                                                                     stderr);
+    fputs("   [:dir[:section]]\tmay be repeated, each with its own directory and section\n",
+                                                                    stderr);
     nroff_output.print_options();
     latex_output.print_options();
     html_output.print_options();
@@ -361,41 +508,133 @@ usage ()
     exit(1);
 }
 
-/* name of the temporary file; kept here so we can blast it if hit with ctrl-C
+/* names of the temporary files; kept here so we can blast them if hit with
+ * ctrl-C.  There may be one for each file being preprocessed ahead of the
+ * parser, and one more for the file being parsed; a slot is free when NULL.
  */
-static char temp_name[20];
+#define MAX_LOOKAHEAD	32
+static char *temp_names[MAX_LOOKAHEAD + 1];
+static int num_temp_files = 0;
 Signal_t (*old_interrupt_handler)();
 
-/* ctrl-C signal handler for use when we have a temporary file */
+#ifdef HAS_MKDTEMP
+/* private directory for the temporary files that include headers, so that
+ * any number of us can run at once in the same directory.  Only the process
+ * that made it removes it.
+ */
+static char *temp_dir = NULL;
+static int temp_dir_pid;
+
+/* remove the private temporary directory, if this process made it */
+static void remove_temp_dir()
+{
+    if (temp_dir && temp_dir_pid == getpid())
+    {
+	rmdir(temp_dir);
+	safe_free(temp_dir);
+    }
+}
+
+/* make the private temporary directory, if we haven't already.
+ * returns FALSE in the event of failure.
+ */
+static boolean make_temp_dir()
+{
+    const char *tmp;
+
+    if (temp_dir)
+	return TRUE;
+
+    if ((tmp = getenv("TMPDIR")) == NULL || *tmp == '\0')
+	tmp = "/tmp";
+
+    temp_dir = strconcat(tmp, "/c2manXXXXXX", NULLCP);
+    if (mkdtemp(temp_dir) == NULL)
+    {
+	my_perror("can't make temporary directory in", tmp);
+	safe_free(temp_dir);
+	return FALSE;
+    }
+
+    temp_dir_pid = getpid();
+    atexit(remove_temp_dir);
+    return TRUE;
+}
+#endif
+
+/* the current directory, for making names absolute */
+const char *current_dir()
+{
+    static char *cwd = NULL;
+    char buf[1024];
+
+    if (cwd == NULL && getcwd(buf, sizeof buf) != NULL)
+	cwd = strduplicate(buf);
+    return cwd;
+}
+
+/* ctrl-C signal handler for use when we have temporary files */
 static Signal_t interrupt_handler(sig)
 int sig;
 {
-    unlink(temp_name);
+    int i;
+
+    for (i = 0; i <= MAX_LOOKAHEAD; i++)
+	if (temp_names[i])	unlink(temp_names[i]);
+#ifdef HAS_MKDTEMP
+    remove_temp_dir();
+#endif
     exit(128 + sig);
 }
 
 /* open a unique temporary file.
  * To be universally accepted by cpp's, the file's name must end in .c; so we
  * can't use mktemp, tmpnam or tmpfile.
+ * If private is set, and we can, the file goes in a private directory;
+ * otherwise it's put in the current one.
  * returns an open stream & sets ret_name to the name.
  */
-FILE *open_temp_file()
+FILE *open_temp_file(ret_name, private)
+char **ret_name;
+boolean private;
 {
-    int fd;
+    int fd, slot;
     long n = getpid();
     FILE *tempf;
+    char *temp_name = NULL, buf[20];
+    const char *dir = NULL;
     boolean remove_temp_file();
 
+    for (slot = 0; slot <= MAX_LOOKAHEAD && temp_names[slot]; slot++)
+	;
+    if (slot > MAX_LOOKAHEAD)
+    {
+	fprintf(stderr,"%s: too many temporary files\n", progname);
+	return NULL;
+    }
+
+#ifdef HAS_MKDTEMP
+    if (private)
+    {
+	if (!make_temp_dir())
+	    return NULL;
+	dir = temp_dir;
+	n = 0;		/* the directory is ours alone */
+    }
+#endif
+
     /* keep generating new names until we hit one that does not exist */
     do
     {
-	/* ideally we'd like to put the temporary file in /tmp, but it must go
-	 * in the current directory because when cpp processes a #include, it
-	 * looks in the same directory as the file doing the include; so if we
-	 * use /tmp/blah.c to fake reading fred.h via `#include "fred.h"', cpp
-	 * will look for /tmp/fred.h, and fail.
+	/* without a private directory, the temporary file must go in the
+	 * current directory because when cpp processes a #include, it looks in
+	 * the same directory as the file doing the include; so if we use
+	 * /tmp/blah.c to fake reading fred.h via `#include "fred.h"', cpp will
+	 * look for /tmp/fred.h, and fail.
 	 */
-	sprintf(temp_name,"c2man%ld.c",n++ % 1000000);
+	sprintf(buf,"c2man%ld.c",n++ % 1000000);
+	safe_free(temp_name);
+	temp_name = dir ? strconcat(dir, "/", buf, NULLCP) : strduplicate(buf);
     }
     while((fd =
 #ifdef HAS_OPEN3
@@ -406,51 +645,234 @@ FILE *open_temp_file()
 						) == -1
 							&& errno == EEXIST);
 
-    /* install interrupt handler to remove the temporary file */
-    old_interrupt_handler = signal(SIGINT, interrupt_handler);
+    temp_names[slot] = temp_name;
+
+    /* install interrupt handler to remove the temporary files */
+    if (num_temp_files++ == 0)
+	old_interrupt_handler = signal(SIGINT, interrupt_handler);
 
     /* convert it to a stream */
     if ((fd == -1 && errno != EEXIST) || (tempf = fdopen(fd, "w")) == NULL)
     {
 	my_perror("error fdopening temp file",temp_name);
-	remove_temp_file();
+	remove_temp_file(temp_name);
 	return NULL;
     }
 
+    *ret_name = temp_name;
     return tempf;
 }
 
-/* remove the temporary file & restore ctrl-C handler.
+/* remove a temporary file opened by open_temp_file, & restore the ctrl-C
+ * handler if it was the last one.  The name is freed.
  * returns FALSE in the event of failure.
  */
-boolean remove_temp_file()
+boolean remove_temp_file(name)
+char *name;
 {
-    int ok = unlink(temp_name) == 0;    /* this should always succeed */
-    signal(SIGINT, old_interrupt_handler);
+    int ok = unlink(name) == 0;    /* this should always succeed */
+    int slot;
+
+    for (slot = 0; slot <= MAX_LOOKAHEAD; slot++)
+	if (temp_names[slot] == name)
+	    temp_names[slot] = NULL;
+    free(name);
+
+    if (--num_temp_files == 0)
+	signal(SIGINT, old_interrupt_handler);
     return ok;
 }
 
+/* is the name, from a line directive of the preprocessor's, that of one of
+ * our temporary files?
+ */
+static boolean is_temp_file(name)
+const char *name;
+{
+    int slot;
+#ifdef HAS_MKDTEMP
+    size_t len;
+#endif
+
+    for (slot = 0; slot <= MAX_LOOKAHEAD; slot++)
+	if (temp_names[slot] && strcmp(name, temp_names[slot]) == 0)
+	    return TRUE;
+
+#ifdef HAS_MKDTEMP
+    if (temp_dir && strncmp(name, temp_dir, len = strlen(temp_dir)) == 0 &&
+	name[len] == '/')
+	return TRUE;
+#endif
+
+    return FALSE;
+}
+
+#ifdef SPAWN_CPP
+/* add an argument to the end of a list */
+static void add_arg(list, arg)
+ArgList *list;
+char *arg;
+{
+    if (list->argc == list->size)
+    {
+	list->size = list->size ? list->size * 2 : 16;
+	if (list->argv == NULL)
+	    list->argv = (char **)safe_malloc(list->size * sizeof *list->argv);
+	else if ((list->argv = (char **)realloc(list->argv,
+					list->size * sizeof *list->argv)) == NULL)
+	    outmem();
+    }
+    list->argv[list->argc++] = arg;
+}
+
+/* add each of the white space separated words in a string to a list */
+static void add_words(list, s)
+ArgList *list;
+const char *s;
+{
+    const char *start;
+    char *word;
+
+    for (;;)
+    {
+	while (isascii(*s) && isspace(*s))	s++;
+	if (*s == '\0')	break;
+
+	for (start = s; *s != '\0' && !(isascii(*s) && isspace(*s)); s++)
+	    ;
+	word = (char *)safe_malloc(s - start + 1);
+	strncpy(word, start, s - start);
+	word[s - start] = '\0';
+	add_arg(list, word);
+    }
+}
+
+/* start the preprocessor on a file, or on the standard input if name is NULL,
+ * with its standard input coming from the file descriptor in, if not -1, and
+ * its output going to the file descriptor out.  The descriptor other, if not
+ * -1, is closed in the child.
+ * returns the process id, or -1 if it couldn't be started.
+ */
+static int spawn_cpp(name, in, out, other)
+const char *name;
+int in;
+int out;
+int other;
+{
+    int pid;
+
+    /* don't let the child inherit anything still buffered */
+    fflush(stdout);
+    fflush(stderr);
+
+    if ((pid = fork()) != 0)
+	return pid;
+
+    /* the child can add the file to its own copy of the arguments */
+    if (name)
+	add_arg(&cpp_args, (char *)name);
+    else
+	add_words(&cpp_args, CPP_STDIN_FLAGS);
+    add_arg(&cpp_args, NULLCP);
+
+    if (other != -1)	close(other);
+    if (in != -1 && in != 0)
+    {
+	if (dup2(in, 0) == -1)	_exit(127);
+	close(in);
+    }
+    if (out != 1)
+    {
+	if (dup2(out, 1) == -1)	_exit(127);
+	close(out);
+    }
+
+    execvp(cpp_args.argv[0], cpp_args.argv);
+    my_perror("error running", cpp_args.argv[0]);
+    _exit(127);
+    /* NOTREACHED */
+}
+
+/* run the preprocessor on a file, or on the standard input if name is NULL,
+ * in which case it reads the stream in, if given.
+ * returns a stream to read its output from, or NULL if it couldn't be started.
+ */
+static FILE *open_cpp(name, in)
+const char *name;
+FILE *in;
+{
+    int fds[2];
+
+    if (pipe(fds) == -1)
+	return NULL;
+
+    if ((cpp_pid = spawn_cpp(name, in ? fileno(in) : -1, fds[1], fds[0])) == -1)
+    {
+	close(fds[0]);
+	close(fds[1]);
+	return NULL;
+    }
+
+    close(fds[1]);
+    return fdopen(fds[0], "r");
+}
+
+/* close the stream from the preprocessor and wait for it to exit.
+ * returns its wait status, as pclose does.
+ */
+static int close_cpp(f)
+FILE *f;
+{
+    int status;
+
+    fclose(f);
+    while (waitpid(cpp_pid, &status, 0) == -1)
+	if (errno != EINTR)
+	    return -1;
+    return status;
+}
+#endif /* SPAWN_CPP */
+
 /* process the specified source file through the pre-processor.
  * This is a lower level routine called by both process_stdin and process_file
  * to actually get the work done once any required temporary files have been
- * generated.
+ * generated.  If name is NULL, the preprocessor reads the wrapper stream on
+ * its standard input instead.
  */
-int process_file_directly(base_cpp_cmd, name)
+int process_file_directly(base_cpp_cmd, name, wrapper)
 const char *base_cpp_cmd;
 const char *name;
+FILE *wrapper;
 {
     char *full_cpp_cmd;
+    int status;
+    double cpp_started;
+
+    /* for the trace, without a name it's reading a wrapper for the base file
+     * or the standard input.
+     */
+    const char *what = name ? name : basefile ? basefile : "stdin";
 
 #ifdef DEBUG
-    fprintf(stderr,"process_file_directly: %s, %s\n", base_cpp_cmd, name);
+    fprintf(stderr,"process_file_directly: %s, %s\n", base_cpp_cmd,
+						    name ? name : "stdin");
 #endif
 
 #ifdef USE_CPP
-    full_cpp_cmd = strconcat(base_cpp_cmd, " ", name, NULLCP);
+    full_cpp_cmd = strconcat(base_cpp_cmd, " ",
+				name ? name : CPP_STDIN_FLAGS, NULLCP);
     if (verbose)
 	fprintf(stderr,"%s: running `%s'\n", progname, full_cpp_cmd);
 
-    if ((yyin = popen(full_cpp_cmd, "r")) == NULL) {
+    cpp_started = trace_time();
+    stats_enter(PHASE_CPP);
+#ifdef SPAWN_CPP
+    yyin = open_cpp(name, wrapper);
+#else
+    yyin = popen(full_cpp_cmd, "r");
+#endif
+    stats_leave();
+    if (yyin == NULL) {
 	my_perror("error running", base_cpp_cmd);
 	free(full_cpp_cmd);
 	return 0;
@@ -468,7 +890,16 @@ const char *name;
 
 #ifdef USE_CPP
     free(full_cpp_cmd);
-    if (pclose(yyin) & 0xFF00)
+    stats_enter(PHASE_CPP);
+#ifdef SPAWN_CPP
+    status = close_cpp(yyin);
+    trace_span("cpp", "cpp", "file", what, cpp_started, cpp_pid);
+#else
+    status = pclose(yyin);
+    trace_span("cpp", "cpp", "file", what, cpp_started, 0);
+#endif
+    stats_leave();
+    if (status & 0xFF00)
 	return 0;
 #else
     if (fclose(yyin))
@@ -481,159 +912,1351 @@ const char *name;
     return !errors;
 }
 
-/* process a specified file */
-int process_file(base_cpp_cmd, name)
-const char *base_cpp_cmd;
+/* does the name look like that of a header file? */
+static boolean is_header_file(name)
 const char *name;
 {
-    char *period;
-    struct stat statbuf;
-    
-#ifdef DEBUG
-    fprintf(stderr,"process_file: %s, %s\n", base_cpp_cmd, name);
-#endif
-    basefile = name;
-    header_file = (period = strrchr(name,'.')) &&
+    const char *period;
+
+    return (period = strrchr(name,'.')) &&
 					(period[1] == 'h' || period[1] == 'H');
+}
 
-    /* use the file's date as the date in the manual page */
-    if (stat(name,&statbuf) != 0)
-    {
-	my_perror("can't stat", name);
-	return 0;
-    }
-    basetime = statbuf.st_mtime;
+/* make name the base file, as seen in the SYNOPSIS of the output */
+static void set_base_file(name)
+const char *name;
+{
+    basefile = name;
+    header_file = is_header_file(name);
+    stats_file(name);
+}
 
-    /* should we do this via a temporary file?
-     * Only if it's a header file and either CPP ignores them, or the user
-     * has specified files to include.
-     *
-     * For HP/Apollo (SR10.3, CC 6.8), we must always use a temporary file,
-     * because its compiler recognizes the special macro "__attribute(p)",
-     * which we cannot redefine in the command line because it has parameters.
-     */
-#ifndef apollo
-    if (header_file && (cppignhdrs || first_include))
+/* does a name from a line directive of the preprocessor's refer to the file?
+ * A NULL name is the standard input.
+ */
+static boolean same_file(name, file)
+const char *name;
+const char *file;
+{
+#ifdef HAS_MKDTEMP
+    const char *cwd;
+    size_t len;
 #endif
-    {
-	FILE *tempf;
-	int ret;
-
-	if (verbose)
-	    fprintf(stderr, "%s: preprocessing via temporary file\n", progname);
 
-	if ((tempf = open_temp_file()) == NULL)
-	    return 0;
+    if (name == NULL || file == NULL)
+	return name == file;
 
-	print_includes(tempf);
-	if (verbose)	print_includes(stderr);
+    if (strcmp(name, file) == 0)
+	return TRUE;
 
-#ifdef apollo
-	fprintf(tempf,"#define __attribute(p)\n", basefile);
+#ifdef HAS_MKDTEMP
+    /* a file included from the private directory is named in full */
+    if (name[0] == '/' && file[0] != '/' && (cwd = current_dir()) &&
+	strncmp(name, cwd, len = strlen(cwd)) == 0 && name[len] == '/')
+	return strcmp(name + len + 1, file) == 0;
 #endif
-	fprintf(tempf,"#include \"%s\"\n", basefile);
-	if (verbose)	fprintf(stderr,"#include \"%s\"\n", basefile);
 
-	if (fclose(tempf) == EOF)
-	{
-	    my_perror("error closing temp file", temp_name);
-	    remove_temp_file();
-	    return 0;
-	}
+    return FALSE;
+}
 
-	/* since we're using a temporary file, it's not the base file */
-	inbasefile = 0;
-	ret = process_file_directly(base_cpp_cmd, temp_name);
-	remove_temp_file();
-	return ret;
-    }
+/* start noting the files the preprocessor reads for an input file, beginning
+ * with the file itself, which may not appear in a line directive of its own.
+ * since is when they started to be read, before the preprocessor was run.
+ */
+static void start_dependencies(name, since)
+const char *name;
+Time_t since;
+{
+    clear_dependencies();
+    dependencies_read_since(since);
+    add_dependency(name);
+}
 
-    /* otherwise, process it directly */
-    inbasefile = 1;
+/* the name a batch wrapper gives itself, so we can tell when the
+ * preprocessor is back in it between the files it includes.
+ */
+#define BATCH_NAME	"<c2man batch>"
 
-    return process_file_directly(base_cpp_cmd,name);
-}
+/* put before each file in a batch; the scanner returns it as a token, so the
+ * parser finishes with one file before the scanner sees where the next starts.
+ */
+#define BATCH_BREAK	"#pragma c2man batch"
 
-/* process the thing on the standard input */
-int process_stdin(base_cpp_cmd)
-const char *base_cpp_cmd;
+/* a file in a batch given to the preprocessor at once */
+typedef struct BatchFile
 {
-    if (isatty(fileno(stdin)))
-	fprintf(stderr,"%s: reading standard input\n", progname);
-
-    header_file = 0;	/* assume it's not since it's from stdin */
-    basefile = NULL;
+    const char *name;
+    Time_t time;		/* its modification time */
+    ManualPage **mark;		/* end of the page list when we got to it */
+    boolean no_terse;		/* was there no terse description then? */
+} BatchFile;
+
+/* the batch being parsed; none when not batching */
+static BatchFile *batch;
+static int batch_size = 0;	/* the number of files */
+static int batch_next;		/* the next one we expect to see */
+static int batch_bad;		/* the first one we can't trust */
+static char *batch_last;	/* the last file the preprocessor was in */
+
+/* note that the preprocessor has moved on to another file in a batch, making
+ * each file the base file in turn as the wrapper includes it.
+ */
+static void batch_enter_file(name)
+const char *name;
+{
+    boolean from_wrapper = batch_last && strcmp(batch_last, BATCH_NAME) == 0;
+    int i;
 
-    /* use the current date in the man page */
-    basetime = time((Time_t *)NULL);
+    safe_free(batch_last);
+    batch_last = name ? strduplicate(name) : NULL;
 
-    inbasefile = 1;		/* reading stdin, we start in the base file */
+    for (i = batch_next; i < batch_size; i++)
+	if (same_file(name, batch[i].name))
+	    break;
+    if (i == batch_size)
+	return;
 
-    /* always use a temp file if the preprocessor can't read stdin, otherwise
-     * only use one if the user specified files for inclusion.
+    /* if one file in the batch includes another later in it, include guards
+     * may stop us seeing the latter when its turn comes, so it and any after
+     * it must be done again.  Likewise if the wrapper seems to skip one.
      */
-    if (!cppcanstdin || first_include)	/* did user specify include files? */
+    if (!from_wrapper)
     {
-    	FILE *tempf;
-	int c, ret;
-
-	if (verbose)
-	    fprintf(stderr,"%s: reading stdin to a temporary file\n", progname);
+	if (i < batch_bad)	batch_bad = i;
+	return;
+    }
+    if (i != batch_next && batch_next < batch_bad)
+	batch_bad = batch_next;
 
-	if ((tempf = open_temp_file()) == NULL)
-	    return 0;
+    batch[i].mark = manual_page_mark();
+    batch[i].no_terse = group_terse == NULL;
 
-	print_includes(tempf);
-	if (verbose)	print_includes(stderr);
-	fprintf(tempf,"#line 1 \"stdin\"\n");
+    set_base_file(batch[i].name);
+    basetime = batch[i].time;
+    batch_next = i + 1;
+}
 
-	while ((c = getchar()) != EOF)
-	    putc(c,tempf);
+/* is the named file, as named in a line directive from the preprocessor, the
+ * base file?  A NULL name is the standard input.
+ */
+boolean is_base_file(name)
+const char *name;
+{
+    if (note_dependencies && name && !is_temp_file(name))
+	add_dependency(name);
 
-	if (fclose(tempf) == EOF)
-	{
-	    my_perror("error closing temp file", temp_name);
-	    remove_temp_file();
-	    return 0;
-	}
-	ret = process_file_directly(base_cpp_cmd, temp_name);
-	remove_temp_file();
-	return ret;
-    }
-    else
+    if (batch_size)
     {
-	char *full_cpp_cmd = strconcat(base_cpp_cmd," ", CPP_STDIN_FLAGS,
-								   NULLCP);
-    
-	if (verbose)
-	    fprintf(stderr,"%s: running `%s'\n", progname, full_cpp_cmd);
-    
-	if ((yyin = popen(full_cpp_cmd, "r")) == NULL) {
-	    my_perror("error running", full_cpp_cmd);
-	    return 0;
-	}
-    
-	parse_file(basefile);
-    
-	free(full_cpp_cmd);
-	if (pclose(yyin) & 0xFF00)
-	    return 0;
-    
-	return !errors;
+	batch_enter_file(name);
+
+	/* between files, the wrapper is part of the one just finished */
+	if (name && strcmp(name, BATCH_NAME) == 0)
+	    return TRUE;
     }
+
+    return same_file(name, basefile);
 }
 
-int
-main (argc, argv)
-int argc;
-char **argv;
+/* what to run the preprocessor on to process a file */
+typedef struct CppInput
 {
-    int i, c, ok = 0;
-    char *s, cbuf[2];
-    const char *base_cpp_cmd;
-    IncludeFile *includefile;
+    char *name;		/* file to give it; NULL to read wrapper instead */
+    FILE *wrapper;	/* anonymous file including the real one */
+    boolean temp;	/* is name a temporary file including the real one? */
+} CppInput;
+
+/* get rid of any wrapper made by open_wrapper below */
+static void release_input(name, input)
+const char *name;
+CppInput *input;
+{
+    if (input->wrapper)
+	fclose(input->wrapper);
+    if (input->temp)
+	remove_temp_file(input->name);
+
+    input->name = (char *)name;
+    input->wrapper = NULL;
+    input->temp = FALSE;
+}
+
+/* start a wrapper to give the preprocessor instead of a file, setting up
+ * input to run it on that.  what says what it's for in error messages.
+ * returns a stream to write the wrapper to, or NULL in the event of failure.
+ */
+static FILE *open_wrapper(input, what)
+CppInput *input;
+const char *what;
+{
+    FILE *tempf;
+
+    if (verbose)
+	fprintf(stderr, "%s: preprocessing via temporary file\n", progname);
+
+#ifdef SPAWN_CPP
+    /* if the preprocessor can read its standard input, the wrapper needn't
+     * have a name at all; the preprocessor takes the current directory as
+     * that of its standard input, so #includes are found just as they would
+     * be from a temporary file there.
+     */
+    if (cppcanstdin)
+    {
+	if ((tempf = input->wrapper = tmpfile()) == NULL)
+	    my_perror("can't create temporary file for", what);
+	input->name = NULL;
+	return tempf;
+    }
+#endif
+
+    if ((tempf = open_temp_file(&input->name, TRUE)) != NULL)
+	input->temp = TRUE;
+    return tempf;
+}
+
+/* the name by which a wrapper should #include a file; free it if it isn't
+ * the one given.
+ */
+static char *wrapped_name(input, name)
+CppInput *input;
+const char *name;
+{
+#ifdef HAS_MKDTEMP
+    /* from the private directory, the file must be named in full */
+    if (input->temp && name[0] != '/' && current_dir())
+	return strconcat(current_dir(), "/", name, NULLCP);
+#endif
+    return (char *)name;
+}
+
+/* add a #include of a file to a wrapper */
+static void wrap_file(input, tempf, name)
+CppInput *input;
+FILE *tempf;
+const char *name;
+{
+    char *include_name = wrapped_name(input, name);
+
+    fprintf(tempf,"#include \"%s\"\n", include_name);
+    if (verbose)	fprintf(stderr,"#include \"%s\"\n", include_name);
+
+    if (include_name != name)	free(include_name);
+}
+
+/* finish writing a wrapper, so the preprocessor can read it.
+ * returns FALSE in the event of failure, when the wrapper is thrown away.
+ */
+static boolean close_wrapper(input, tempf, what)
+CppInput *input;
+FILE *tempf;
+const char *what;
+{
+    boolean ok;
+
+    /* the preprocessor reads an anonymous wrapper from the start */
+    if (input->wrapper)
+	ok = fflush(tempf) != EOF && fseek(tempf, 0L, 0) == 0;
+    else
+	ok = fclose(tempf) != EOF;
+
+    if (!ok)
+    {
+	my_perror("error closing temp file", input->name ? input->name : what);
+	release_input(what, input);
+    }
+    return ok;
+}
+
+/* get a file ready to be run through the preprocessor.
+ * Fills in input with what it should actually be given: the file itself, or
+ * a wrapper that includes it.
+ * returns FALSE in the event of failure.
+ */
+static boolean prepare_file(name, input)
+const char *name;
+CppInput *input;
+{
+    FILE *tempf;
+
+    input->name = (char *)name;
+    input->wrapper = NULL;
+    input->temp = FALSE;
+
+    /* should we do this via a temporary file?
+     * Only if it's a header file and either CPP ignores them, or the user
+     * has specified files to include.
+     *
+     * For HP/Apollo (SR10.3, CC 6.8), we must always use a temporary file,
+     * because its compiler recognizes the special macro "__attribute(p)",
+     * which we cannot redefine in the command line because it has parameters.
+     */
+#ifndef apollo
+    if (!is_header_file(name) || !(cppignhdrs || first_include))
+	return TRUE;
+#endif
+
+    if ((tempf = open_wrapper(input, name)) == NULL)
+    {
+	input->name = (char *)name;
+	return FALSE;
+    }
+
+    print_includes(tempf);
+    if (verbose)	print_includes(stderr);
+
+#ifdef apollo
+    fprintf(tempf,"#define __attribute(p)\n");
+#endif
+    wrap_file(input, tempf, name);
+
+    return close_wrapper(input, tempf, name);
+}
+
+#ifdef USE_CPP
+/* everything besides the files it reads that the preprocessor's output on a
+ * file depends on, as the key for its cache entry.
+ */
+static char *cache_key(base_cpp_cmd, name, input)
+const char *base_cpp_cmd;
+const char *name;
+CppInput *input;
+{
+    IncludeFile *incfile;
+    const char *cwd = current_dir();
+    char *key = strconcat(base_cpp_cmd, "\n", cwd ? cwd : "", "\n", name, "\n",
+									NULLCP);
+
+    /* a wrapper is made the same way each time, from the -i options */
+    if (input->name != name)
+    {
+	key = strappend(key, "wrapper\n", NULLCP);
+	for (incfile = first_include; incfile; incfile = incfile->next)
+	    key = strappend(key, incfile->name, "\n", NULLCP);
+    }
+    return key;
+}
+
+/* run the preprocessor to completion, spooling its output into an anonymous
+ * temporary file.
+ * returns the spool, rewound, and sets status as pclose does; or returns NULL
+ * if the preprocessor couldn't be run.
+ */
+static FILE *spool_cpp(base_cpp_cmd, input, status)
+const char *base_cpp_cmd;
+CppInput *input;
+int *status;
+{
+    char *full_cpp_cmd;
+    FILE *spool;
+    double started = trace_time();
+#ifdef SPAWN_CPP
+    int pid;
+#else
+    FILE *cpp;
+    char buf[BUFSIZ];
+    size_t n;
+#endif
+
+    if ((spool = tmpfile()) == NULL)
+	return NULL;
+
+    full_cpp_cmd = strconcat(base_cpp_cmd, " ", input->name ?
+			    input->name : CPP_STDIN_FLAGS, NULLCP);
+    if (verbose)
+	fprintf(stderr,"%s: running `%s'\n", progname, full_cpp_cmd);
+
+#ifdef SPAWN_CPP
+    if ((pid = spawn_cpp(input->name, input->wrapper ?
+			 fileno(input->wrapper) : -1, fileno(spool), -1)) == -1)
+    {
+	fclose(spool);
+	spool = NULL;
+    }
+    else
+    {
+	while (waitpid(pid, status, 0) == -1)
+	    if (errno != EINTR)
+	    {
+		*status = -1;
+		break;
+	    }
+	trace_span("cpp", "cpp", "file", input->name ? input->name : "stdin",
+								started, pid);
+    }
+#else
+    if ((cpp = popen(full_cpp_cmd, "r")) == NULL)
+    {
+	fclose(spool);
+	spool = NULL;
+    }
+    else
+    {
+	while ((n = fread(buf, 1, sizeof buf, cpp)) > 0)
+	    fwrite(buf, 1, n, spool);
+	*status = pclose(cpp);
+	trace_span("cpp", "cpp", "file", input->name ? input->name : "stdin",
+								started, 0);
+    }
+#endif
+
+    free(full_cpp_cmd);
+    if (spool)	rewind(spool);
+    return spool;
+}
+
+/* process a file through the cache, reading the preprocessor's output from
+ * there if it's still good, or running the preprocessor and storing its
+ * output there if not.
+ */
+static int process_file_cached(base_cpp_cmd, name, input)
+const char *base_cpp_cmd;
+const char *name;
+CppInput *input;
+{
+    char *key = cache_key(base_cpp_cmd, name, input);
+    char *entry = cache_entry(name, key);
+    int old_errors = errors, status = 0;
+    Time_t since = time((Time_t *)NULL);
+    boolean hit;
+
+    if ((hit = entry && (yyin = cache_lookup(entry, key)) != NULL))
+    {
+	if (verbose)
+	    fprintf(stderr,"%s: using cached output for %s\n", progname, name);
+    }
+    else
+    {
+	stats_enter(PHASE_CPP);
+	yyin = spool_cpp(base_cpp_cmd, input, &status);
+	stats_leave();
+	if (yyin == NULL)
+	{
+	    my_perror("error running", base_cpp_cmd);
+	    free(key);
+	    safe_free(entry);
+	    return 0;
+	}
+    }
+
+    start_dependencies(name, since);
+    parse_file(input->name);
+
+    /* an entry is no good if a file changed while it was being read */
+    if (!hit && entry && !(status & 0xFF00) && errors == old_errors &&
+	dependencies_settled())
+	cache_store(entry, key, yyin);
+    fclose(yyin);
+
+    free(key);
+    safe_free(entry);
+
+    if (status & 0xFF00)
+	return 0;
+    return !errors;
+}
+#endif /* USE_CPP */
+
+/* should a file be read directly, without the preprocessor?  Not if the -i
+ * files must be wrapped around it, unless the user insists.
+ */
+static boolean direct_file(name)
+const char *name;
+{
+    if (direct_input == DIRECT_AUTO && first_include && is_header_file(name))
+	return FALSE;
+    return read_directly(name);
+}
+
+/* parse a file read directly, without the preprocessor; the scanner follows
+ * any files it #includes itself.
+ */
+static int read_file_directly(name)
+const char *name;
+{
+    boolean mapped;
+
+    if (verbose)	fprintf(stderr,"%s: reading %s\n", progname, name);
+
+    /* scan it in place if we can, rather than copying it through stdio */
+    stats_enter(PHASE_CPP);
+    if (!(mapped = scan_mapped_file(name)))
+	yyin = fopen(name, "r");
+    stats_leave();
+    if (!mapped && yyin == NULL)
+    {
+	my_perror("cannot open", name);
+	return 0;
+    }
+
+    parse_file(name);
+
+    if (!mapped && fclose(yyin) == EOF)
+    {
+	my_perror("error closing", name);
+	return 0;
+    }
+    return !errors;
+}
+
+/* process a specified file */
+int process_file(base_cpp_cmd, name)
+const char *base_cpp_cmd;
+const char *name;
+{
+    struct stat statbuf;
+    CppInput input;
+    int ret;
+    double started = trace_time();
+    
+#ifdef DEBUG
+    fprintf(stderr,"process_file: %s, %s\n", base_cpp_cmd, name);
+#endif
+    set_base_file(name);
+
+    /* use the file's date as the date in the manual page */
+    if (stat(name,&statbuf) != 0)
+    {
+	my_perror("can't stat", name);
+	return 0;
+    }
+    basetime = statbuf.st_mtime;
+
+    if (direct_file(name))
+    {
+	start_dependencies(name, time((Time_t *)NULL));
+	inbasefile = TRUE;
+	ret = read_file_directly(name);
+    }
+    else
+    {
+	if (!prepare_file(name, &input))
+	    return 0;
+
+	/* if we're using a wrapper, it's not the base file */
+	inbasefile = input.name == name;
+
+#ifdef USE_CPP
+	if (cache_dir)
+	    ret = process_file_cached(base_cpp_cmd, name, &input);
+	else
+#endif
+	{
+	    start_dependencies(name, time((Time_t *)NULL));
+	    ret = process_file_directly(base_cpp_cmd, input.name,
+							    input.wrapper);
+	}
+	release_input(name, &input);
+    }
+
+    manifest_input_done(name);
+    trace_span("process_file", "file", "file", name, started, 0);
+    return ret;
+}
+
+/* is it a lex or yacc source?  These are scanned differently from the start,
+ * so can't share a batch with anything else.
+ */
+static boolean is_lex_yacc_file(name)
+const char *name;
+{
+    size_t len = strlen(name);
+
+    return len > 2 && (strcmp(name + len - 2, ".l") == 0 ||
+		       strcmp(name + len - 2, ".y") == 0);
+}
+
+/* parse a batch of files through a single run of the preprocessor.
+ * returns the number of files done, which may be fewer than given if some
+ * must be done again, or -1 in the event of failure.
+ */
+static int process_batch(base_cpp_cmd, files, num)
+const char *base_cpp_cmd;
+BatchFile *files;
+int num;
+{
+    CppInput input;
+    FILE *tempf;
+    int i, ret;
+    double started = trace_time();
+
+    input.name = NULL;
+    input.wrapper = NULL;
+    input.temp = FALSE;
+
+    if ((tempf = open_wrapper(&input, files[0].name)) == NULL)
+	return -1;
+
+    print_includes(tempf);
+    if (verbose)	print_includes(stderr);
+
+#ifdef apollo
+    fprintf(tempf,"#define __attribute(p)\n");
+#endif
+    fprintf(tempf,"#line 1 \"%s\"\n", BATCH_NAME);
+    for (i = 0; i < num; i++)
+    {
+	files[i].mark = NULL;
+	fprintf(tempf,"%s\n", BATCH_BREAK);
+	wrap_file(&input, tempf, files[i].name);
+    }
+
+    if (!close_wrapper(&input, tempf, files[0].name))
+	return -1;
+
+    batch = files;
+    batch_size = num;
+    batch_next = 0;
+    batch_bad = num;
+
+    /* we're in the wrapper until it includes the first file */
+    set_base_file(files[0].name);
+    basetime = files[0].time;
+    inbasefile = FALSE;
+
+    /* there's no telling which file in the batch read which header, so each
+     * depends on all of them.
+     */
+    start_dependencies(files[0].name, time((Time_t *)NULL));
+    for (i = 1; i < num; i++)
+	add_dependency(files[i].name);
+
+    ret = process_file_directly(base_cpp_cmd, input.name, input.wrapper);
+    release_input(NULLCP, &input);
+
+    if (batch_next < batch_bad)	batch_bad = batch_next;
+    batch_size = 0;
+    safe_free(batch_last);
+    trace_span("process_batch", "file", "first", files[0].name, started, 0);
+
+    if (!ret)
+	return -1;
+
+    for (i = 0; i < batch_bad; i++)
+	manifest_input_done(files[i].name);
+
+    /* throw away what we got from any that must be done again */
+    for (i = batch_bad; i < num; i++)
+	if (files[i].mark)
+	{
+	    truncate_manual_pages(files[i].mark);
+	    if (files[i].no_terse && !terse_specified)
+		safe_free(group_terse);
+	    break;
+	}
+
+    /* leave the base file as a serial run would */
+    if (batch_bad > 0)
+    {
+	set_base_file(files[batch_bad - 1].name);
+	basetime = files[batch_bad - 1].time;
+    }
+
+    return batch_bad;
+}
+
+/* process a list of files, giving the preprocessor up to max_batch of them at
+ * once.
+ */
+int process_files_batched(base_cpp_cmd, names, num)
+const char *base_cpp_cmd;
+char **names;
+int num;
+{
+    BatchFile *files = (BatchFile *)safe_malloc(max_batch * sizeof *files);
+    struct stat statbuf;
+    int i = 0, n, done, ok = 1;
+
+    while (ok && i < num)
+    {
+	/* a file that can't be batched, one read without the preprocessor, or
+	 * one we can't stat, is left to be done by itself, so any error is
+	 * reported in order.  Only headers are given the -i files, so nothing
+	 * else can go in a batch with them.
+	 */
+	for (n = 0; n < max_batch && i + n < num; n++)
+	{
+	    if (is_lex_yacc_file(names[i + n]) ||
+		(first_include && !is_header_file(names[i + n])) ||
+		direct_file(names[i + n]) ||
+		stat(names[i + n],&statbuf) != 0)
+		break;
+	    files[n].name = names[i + n];
+	    files[n].time = statbuf.st_mtime;
+	}
+
+	if (n < 2)
+	    done = 0;
+	else if ((done = process_batch(base_cpp_cmd, files, n)) < 0)
+	{
+	    ok = 0;
+	    break;
+	}
+
+	/* make sure we get somewhere */
+	if (done == 0)
+	{
+	    ok = process_file(base_cpp_cmd, names[i]);
+	    done = 1;
+	}
+	i += done;
+    }
+
+    free(files);
+    return ok;
+}
+
+#ifdef HAS_FORK
+/* a worker process parsing a single input file.  Each leaves its manual pages
+ * in an anonymous temporary file, to be read back in the same order the files
+ * were given so the output is identical to that of a serial run.
+ */
+typedef struct Worker
+{
+    const char *name;	/* input file */
+    int pid;		/* process id; 0 once it has exited */
+    int status;		/* exit status */
+    FILE *pages;	/* where it leaves its manual pages */
+} Worker;
+
+/* how many files workers may be started ahead of the oldest one not yet
+ * merged, for each job allowed.  This bounds the number of finished workers
+ * left waiting on a slow one.
+ */
+#define WORKER_LOOKAHEAD 4
+
+/* start a worker process on a file */
+static boolean start_worker(base_cpp_cmd, w)
+const char *base_cpp_cmd;
+Worker *w;
+{
+    int ok;
+
+    if ((w->pages = tmpfile()) == NULL)
+    {
+	my_perror("can't create temporary file for", w->name);
+	return FALSE;
+    }
+
+    /* don't let the child inherit anything still buffered */
+    fflush(stdout);
+    fflush(stderr);
+
+    switch (w->pid = fork())
+    {
+    case -1:
+	my_perror("can't start worker process for", w->name);
+	fclose(w->pages);
+	return FALSE;
+
+    case 0:
+	/* the child starts with an empty page list and no terse description
+	 * of its own, and passes back whatever it finds.
+	 */
+	forget_manual_pages();
+	forget_stats();
+	if (!terse_specified)	group_terse = NULL;
+	errors = 0;
+
+	/* the workers would garble the snapshots sent to a server */
+	send_snapshots((FILE *)NULL);
+
+	ok = process_file(base_cpp_cmd, w->name);
+
+	/* the files it read and its statistics follow the pages */
+	if (!write_manual_pages(w->pages, firstpage,
+			    terse_specified ? NULLCP : group_terse) ||
+	    (write_dependencies(w->pages), write_stats(w->pages),
+	     fflush(w->pages) == EOF))
+	{
+	    my_perror("error writing manual pages for", w->name);
+	    ok = 0;
+	}
+#ifdef HAS_MKDTEMP
+	remove_temp_dir();	/* we won't be running atexit handlers */
+#endif
+	_exit(!ok);
+    }
+
+    return TRUE;
+}
+
+/* wait for a worker to exit, or just check if it has when not blocking,
+ * and note its status.  Only the worker's own process is waited for, so no
+ * preprocessor or other child is collected by mistake.
+ * Returns TRUE if it has exited.
+ */
+static boolean reap_worker(w, block)
+Worker *w;
+boolean block;
+{
+    int pid, status;
+
+    while ((pid = waitpid(w->pid, &status, block ? 0 : WNOHANG)) == -1 &&
+								errno == EINTR)
+	;
+
+    if (pid == -1)
+    {
+	my_perror("error waiting for", "worker process");
+	exit(1);
+    }
+
+    if (pid == 0)
+	return FALSE;
+
+    w->pid = 0;
+    w->status = status;
+    return TRUE;
+}
+
+/* add the pages from a finished worker to the list */
+static int merge_worker(w)
+Worker *w;
+{
+    char *terse;
+    boolean changed;
+    int ok = w->status == 0;
+
+    if (ok)
+    {
+	rewind(w->pages);
+	if (!read_manual_pages(w->pages, &terse))
+	    ok = 0;
+	/* only the first file's terse description counts */
+	else if (terse)
+	{
+	    if (group_terse == NULL)
+		group_terse = terse;
+	    else
+		free(terse);
+	}
+
+	/* the files it read follow the pages, then its statistics */
+	if (ok && (!read_dependencies(w->pages, &changed) ||
+		   !read_stats(w->pages)))
+	    ok = 0;
+
+	if (ok)
+	    manifest_input_done(w->name);
+	else
+	    fprintf(stderr,"%s: bad manual page list from worker for %s\n",
+							    progname, w->name);
+    }
+
+    fclose(w->pages);
+    return ok;
+}
+
+/* process a list of files using up to max_jobs worker processes at once */
+int process_files_parallel(base_cpp_cmd, names, num)
+const char *base_cpp_cmd;
+char **names;
+int num;
+{
+    Worker *workers = (Worker *)safe_malloc(num * sizeof *workers);
+    int started = 0, merged = 0, running = 0, ok = 1, i;
+
+    while (merged < started || (ok && started < num))
+    {
+	while (ok && started < num && running < max_jobs &&
+		    started - merged < max_jobs * WORKER_LOOKAHEAD)
+	{
+	    workers[started].name = names[started];
+	    if (!start_worker(base_cpp_cmd, &workers[started]))
+	    {
+		ok = 0;
+		break;
+	    }
+	    started++;
+	    running++;
+	}
+
+	if (merged == started)
+	    break;
+
+	/* merge strictly in order, so wait for the oldest first, but count
+	 * any others that have finished meanwhile to start more.
+	 */
+	if (workers[merged].pid != 0)
+	{
+	    for (i = merged + 1; i < started; i++)
+		if (workers[i].pid != 0 && reap_worker(&workers[i], FALSE))
+		    running--;
+	    reap_worker(&workers[merged], TRUE);
+	    running--;
+	    continue;
+	}
+
+	/* after a failure, just collect the remaining workers */
+	if (ok)
+	    ok = merge_worker(&workers[merged]);
+	else
+	    fclose(workers[merged].pages);
+	merged++;
+    }
+
+    /* leave the base file as a serial run would */
+    if (ok)	set_base_file(names[num - 1]);
+
+    free(workers);
+    return ok;
+}
+
+/* a preprocessor run started ahead of the parser.  Its output is spooled into
+ * an anonymous temporary file, so it can run to completion while earlier files
+ * are still being parsed.
+ */
+typedef struct CppJob
+{
+    const char *name;	/* input file */
+    Time_t time;	/* its modification time */
+    CppInput input;	/* what the preprocessor is given */
+    boolean started;	/* did we manage to start it ahead? */
+    boolean failed;	/* did getting it ready fail? */
+    boolean cached;	/* is its output from the cache instead? */
+    int pid;		/* process id; 0 once it has exited */
+    int status;		/* exit status */
+    double start_time;	/* when it was started, for the trace */
+    Time_t since;	/* and when its files started to be read */
+    FILE *output;	/* where its output is spooled */
+    char *key;		/* cache key, if there's a cache */
+    char *entry;	/* cache entry to store the output in; NULL if none */
+} CppJob;
+
+/* start the preprocessor on a file ahead of the parser.
+ * If it can't be started, or isn't needed, the file is left to be processed
+ * the ordinary way when its turn comes, so any errors are still reported in
+ * order.
+ */
+static void start_cpp(base_cpp_cmd, job)
+const char *base_cpp_cmd;
+CppJob *job;
+{
+    struct stat statbuf;
+    char *full_cpp_cmd;
+
+    job->started = job->failed = job->cached = FALSE;
+    job->key = job->entry = NULL;
+    job->since = time((Time_t *)NULL);
+
+    if (stat(job->name,&statbuf) != 0 || direct_file(job->name))
+	return;
+    job->time = statbuf.st_mtime;
+
+    if (!prepare_file(job->name, &job->input))
+    {
+	job->failed = TRUE;
+	return;
+    }
+
+    /* there's no need to run it at all if its output is in the cache */
+    if (cache_dir)
+    {
+	job->key = cache_key(base_cpp_cmd, job->name, &job->input);
+	job->entry = cache_entry(job->name, job->key);
+	if (job->entry &&
+	    (job->output = cache_lookup(job->entry, job->key)) != NULL)
+	{
+	    if (verbose)
+		fprintf(stderr,"%s: using cached output for %s\n", progname,
+								job->name);
+	    safe_free(job->entry);
+	    job->pid = job->status = 0;
+	    job->started = job->cached = TRUE;
+	    return;
+	}
+    }
+
+    if ((job->output = tmpfile()) == NULL)
+    {
+	release_input(job->name, &job->input);
+	safe_free(job->key);
+	safe_free(job->entry);
+	return;
+    }
+
+    full_cpp_cmd = strconcat(base_cpp_cmd, " ", job->input.name ?
+			    job->input.name : CPP_STDIN_FLAGS, NULLCP);
+    if (verbose)
+	fprintf(stderr,"%s: running `%s'\n", progname, full_cpp_cmd);
+
+    job->start_time = trace_time();
+#ifdef SPAWN_CPP
+    job->pid = spawn_cpp(job->input.name, job->input.wrapper ?
+			 fileno(job->input.wrapper) : -1, fileno(job->output), -1);
+#else
+    /* don't let the child inherit anything still buffered */
+    fflush(stdout);
+    fflush(stderr);
+
+    if ((job->pid = fork()) == 0)
+    {
+	if (dup2(fileno(job->output), 1) != -1)
+	    execl("/bin/sh", "sh", "-c", full_cpp_cmd, NULLCP);
+	_exit(127);
+    }
+#endif
+
+    if (job->pid == -1)
+    {
+	fclose(job->output);
+	release_input(job->name, &job->input);
+	safe_free(job->key);
+	safe_free(job->entry);
+    }
+    else
+	job->started = TRUE;
+
+    free(full_cpp_cmd);
+}
+
+/* wait for the preprocessor on a file to exit.  Only its own process is
+ * waited for, so no worker or other child is collected by mistake.
+ */
+static void wait_cpp(job)
+CppJob *job;
+{
+    int status;
+
+    if (job->pid == 0)
+	return;
+
+    while (waitpid(job->pid, &status, 0) == -1)
+	if (errno != EINTR)
+	{
+	    my_perror("error waiting for", "preprocessor");
+	    exit(1);
+	}
+
+    trace_span("cpp", "cpp", "file", job->name, job->start_time, job->pid);
+    job->pid = 0;
+    job->status = status;
+}
+
+/* parse the spooled output of the preprocessor on a file */
+static int finish_cpp(base_cpp_cmd, job)
+const char *base_cpp_cmd;
+CppJob *job;
+{
+    int old_errors;
+    double started = trace_time();
+
+    if (job->failed)
+	return 0;
+    if (!job->started)
+	return process_file(base_cpp_cmd, job->name);
+
+    set_base_file(job->name);
+    basetime = job->time;
+    inbasefile = job->input.name == job->name;
+
+    stats_enter(PHASE_CPP);
+    wait_cpp(job);
+    stats_leave();
+
+    start_dependencies(job->name, job->since);
+    old_errors = errors;
+
+    yyin = job->output;
+    if (!job->cached)	rewind(yyin);
+    parse_file(job->input.name);
+
+    if (job->entry && !(job->status & 0xFF00) && errors == old_errors &&
+	dependencies_settled())
+	cache_store(job->entry, job->key, yyin);
+    fclose(yyin);
+
+    release_input(job->name, &job->input);
+    safe_free(job->key);
+    safe_free(job->entry);
+
+    manifest_input_done(job->name);
+    trace_span("process_file", "file", "file", job->name, started, 0);
+
+    if (job->status & 0xFF00)
+	return 0;
+
+    return !errors;
+}
+
+/* throw away a preprocessor run that won't be needed after all */
+static void discard_cpp(job)
+CppJob *job;
+{
+    if (!job->started)
+	return;
+
+    if (job->pid != 0)	kill(job->pid, SIGTERM);
+    wait_cpp(job);
+
+    fclose(job->output);
+    release_input(job->name, &job->input);
+    safe_free(job->key);
+    safe_free(job->entry);
+}
+
+/* process a list of files, keeping the preprocessor running on up to
+ * cpp_lookahead of them ahead of the one being parsed.
+ */
+int process_files_pipelined(base_cpp_cmd, names, num)
+const char *base_cpp_cmd;
+char **names;
+int num;
+{
+    CppJob *jobs = (CppJob *)safe_malloc(num * sizeof *jobs);
+    int started = 0, i, ok = 1;
+
+    for (i = 0; ok && i < num; i++)
+    {
+	while (started < num && started <= i + cpp_lookahead)
+	{
+	    jobs[started].name = names[started];
+	    start_cpp(base_cpp_cmd, &jobs[started++]);
+	}
+
+	ok = finish_cpp(base_cpp_cmd, &jobs[i]);
+    }
+
+    /* after a failure, don't leave the rest running */
+    for (; i < started; i++)
+	discard_cpp(&jobs[i]);
+
+    free(jobs);
+    return ok;
+}
+#endif /* HAS_FORK */
+
+/* process a list of files, in whichever way the options ask for */
+static int process_files(base_cpp_cmd, names, num)
+const char *base_cpp_cmd;
+char **names;
+int num;
+{
+    int i, ok = 1;
+
+#ifdef HAS_FORK
+    if (max_jobs > 1 && num > 1)
+	return process_files_parallel(base_cpp_cmd, names, num);
+#endif
+    if (max_batch > 1 && num > 1)
+	return process_files_batched(base_cpp_cmd, names, num);
+#ifdef HAS_FORK
+    if (cpp_lookahead > 0 && num > 1)
+	return process_files_pipelined(base_cpp_cmd, names, num);
+#endif
+
+    for (i = 0; ok && i < num; i++)
+	ok = process_file(base_cpp_cmd, names[i]);
+    return ok;
+}
+
+/* sum up the options and input files, so the manifest can tell if a run is
+ * like the last.
+ */
+static char *run_fingerprint(optc, optv, names, num)
+int optc;
+char **optv;
+char **names;
+int num;
+{
+    char buf[32], *fingerprint;
+    int i;
+
+    sprintf(buf, "%d.%d", VERSION, PATCHLEVEL);
+    fingerprint = strduplicate(buf);
+    for (i = 1; i < optc; i++)
+	fingerprint = strappend(fingerprint, "\n", optv[i], NULLCP);
+
+    /* the date may come from the environment instead */
+    if (date_given)
+    {
+	sprintf(buf, "%ld", (long)given_date);
+	fingerprint = strappend(fingerprint, "\ndate ", buf,
+				clamp_date ? " or earlier" : "", NULLCP);
+    }
+    fingerprint = strappend(fingerprint, "\n--", NULLCP);
+    for (i = 0; i < num; i++)
+	fingerprint = strappend(fingerprint, "\n", names[i], NULLCP);
+    return fingerprint;
+}
+
+/* parse a date given as the number of seconds since the epoch, or as
+ * yyyy-mm-dd, which is taken as midnight UTC.
+ * returns FALSE if it's no good.
+ */
+static boolean parse_date(s, date)
+const char *s;
+Time_t *date;
+{
+    static const int month_days[] =
+	{ 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    int year, month, day, y, m, len = 0;
+    boolean leap;
+    long days;
+
+    if (*s == '\0')
+	return FALSE;
+    if (strspn(s, "0123456789") == strlen(s))
+    {
+	*date = (Time_t)atol(s);
+	return TRUE;
+    }
+
+    if (sscanf(s, "%4d-%2d-%2d%n", &year, &month, &day, &len) != 3 ||
+	s[len] != '\0' || year < 1970 || month < 1 || month > 12)
+	return FALSE;
+
+    leap = year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+    if (day < 1 || day > month_days[month - 1] + (month == 2 && leap))
+	return FALSE;
+
+    days = day - 1;
+    for (y = 1970; y < year; y++)
+	days += (y % 4 == 0 && (y % 100 != 0 || y % 400 == 0)) ? 366 : 365;
+    for (m = 1; m < month; m++)
+	days += month_days[m - 1] + (m == 2 && leap);
+    *date = (Time_t)(days * 24L * 60 * 60);
+    return TRUE;
+}
+
+/* process the thing on the standard input */
+int process_stdin(base_cpp_cmd)
+const char *base_cpp_cmd;
+{
+    if (isatty(fileno(stdin)))
+	fprintf(stderr,"%s: reading standard input\n", progname);
+
+    header_file = 0;	/* assume it's not since it's from stdin */
+    basefile = NULL;
+    stats_file("stdin");
+
+    /* use the current date in the man page */
+    basetime = time((Time_t *)NULL);
+
+    inbasefile = 1;		/* reading stdin, we start in the base file */
+
+    /* there's no looking through the standard input first to see if it
+     * needs the preprocessor, so it's only read directly if the user insists.
+     */
+    if (direct_input == DIRECT_ALWAYS)
+    {
+	yyin = stdin;
+	parse_file(NULLCP);
+	return !errors;
+    }
+
+    /* always use a temp file if the preprocessor can't read stdin, otherwise
+     * only use one if the user specified files for inclusion.
+     */
+    if (!cppcanstdin || first_include)	/* did user specify include files? */
+    {
+    	FILE *tempf;
+	char *temp_name = NULL;
+	int c, ret;
+
+	if (verbose)
+	    fprintf(stderr,"%s: reading stdin to a temporary file\n", progname);
+
+#ifdef SPAWN_CPP
+	/* if the preprocessor can read stdin, it can have the lot from an
+	 * anonymous file
+	 */
+	if (cppcanstdin)
+	{
+	    if ((tempf = tmpfile()) == NULL)
+	    {
+		my_perror("can't create temporary file for", "stdin");
+		return 0;
+	    }
+	}
+	else
+#endif
+	/* this must go in the current directory, where any files it includes
+	 * are looked for
+	 */
+	if ((tempf = open_temp_file(&temp_name, FALSE)) == NULL)
+	    return 0;
+
+	print_includes(tempf);
+	if (verbose)	print_includes(stderr);
+	fprintf(tempf,"#line 1 \"stdin\"\n");
+
+	while ((c = getchar()) != EOF)
+	    putc(c,tempf);
+
+	if (temp_name == NULL)
+	{
+	    if (fflush(tempf) == EOF || fseek(tempf, 0L, 0) != 0)
+	    {
+		my_perror("error writing temporary file for", "stdin");
+		fclose(tempf);
+		return 0;
+	    }
+	    ret = process_file_directly(base_cpp_cmd, NULLCP, tempf);
+	    fclose(tempf);
+	    return ret;
+	}
+
+	if (fclose(tempf) == EOF)
+	{
+	    my_perror("error closing temp file", temp_name);
+	    remove_temp_file(temp_name);
+	    return 0;
+	}
+	ret = process_file_directly(base_cpp_cmd, temp_name, (FILE *)NULL);
+	remove_temp_file(temp_name);
+	return ret;
+    }
+    else
+    {
+	char *full_cpp_cmd = strconcat(base_cpp_cmd," ", CPP_STDIN_FLAGS,
+								   NULLCP);
+	int status;
+	double started = trace_time();
+    
+	if (verbose)
+	    fprintf(stderr,"%s: running `%s'\n", progname, full_cpp_cmd);
+    
+#ifdef SPAWN_CPP
+	if ((yyin = open_cpp(NULLCP, (FILE *)NULL)) == NULL) {
+#else
+	if ((yyin = popen(full_cpp_cmd, "r")) == NULL) {
+#endif
+	    my_perror("error running", full_cpp_cmd);
+	    return 0;
+	}
+    
+	parse_file(basefile);
+    
+	free(full_cpp_cmd);
+	stats_enter(PHASE_CPP);
+#ifdef SPAWN_CPP
+	status = close_cpp(yyin);
+	trace_span("cpp", "cpp", "file", "stdin", started, cpp_pid);
+#else
+	status = pclose(yyin);
+	trace_span("cpp", "cpp", "file", "stdin", started, 0);
+#endif
+	stats_leave();
+	if (status & 0xFF00)
+	    return 0;
+    
+	return !errors;
+    }
+}
+
+int
+run_c2man (argc, argv)
+int argc;
+char **argv;
+{
+    int i, c, ok = 0;
+    char *s, cbuf[2];
+    const char *base_cpp_cmd;
+    IncludeFile *includefile;
     ExcludeSection *excludesection;
     char *cpp_opts;
+    char **input;				/* the input files */
+    int num_inputs;
 #ifdef HAS_LINK
     enum LinkType link_type = LINK_HARD;	/* for -g/G */
 #else
@@ -651,17 +2274,39 @@ char **argv;
     cpp_opts = strconcat("-\"D__C2MAN__=", cbuf, "\"",NULLCP);
 #else
     cpp_opts = strconcat("-D__C2MAN__=", cbuf, NULLCP);
+#ifdef SPAWN_CPP
+    add_arg(&cpp_opt_args, strduplicate(cpp_opts));
+#endif
 #ifdef NeXT
     cpp_opts = strappend(cpp_opts, " -D_NEXT_SOURCE", NULLCP);
+#ifdef SPAWN_CPP
+    add_arg(&cpp_opt_args, strduplicate("-D_NEXT_SOURCE"));
+#endif
 #endif /* !NeXT */
 #endif /* !VMS  */
 
+    /* with SOURCE_DATE_EPOCH, no page is dated any later, so they come out
+     * the same whenever they're made.
+     */
+    if ((s = getenv("SOURCE_DATE_EPOCH")) != NULL && *s)
+    {
+	if (!parse_date(s, &given_date))
+	{
+	    fprintf(stderr,"%s: bad SOURCE_DATE_EPOCH: %s\n", progname, s);
+	    exit(1);
+	}
+	date_given = clamp_date = TRUE;
+    }
+
     /* Scan command line options. */
-    while ((c = getopt(argc, argv, "P:D:F:I:psU:Vvo:eM:H:G:gi:x:S:l:LT:nO:kbB"))
+    while ((c = getopt(argc, argv, "P:D:F:I:psU:Vvo:eM:H:G:gi:x:S:l:LT:nO:kbBj:J:a:C:mudRf:X:wz:t:E:c:N:qQ:K"))
 								    != EOF)
     {
 	switch (c) {
 	case 'I':
+	    /* for the scanner too, when it reads files itself */
+	    add_include_dir(optarg);
+	    /* FALLTHROUGH */
 	case 'D':
 	case 'U':
 	    cbuf[0] = c; cbuf[1] = '\0';
@@ -669,6 +2314,9 @@ char **argv;
 		cpp_opts = strappend(cpp_opts," -",cbuf,optarg,NULLCP);
 	    else
 		cpp_opts = strconcat("-",cbuf,optarg,NULLCP);
+#ifdef SPAWN_CPP
+	    add_arg(&cpp_opt_args, strconcat("-",cbuf,optarg,NULLCP));
+#endif
 	    break;
 	case 'P':
 	    cpp_cmd = optarg;
@@ -809,6 +2457,27 @@ char **argv;
                         break;
 	    default:	usage();
 	    }
+
+	    /* each -T adds another format, perhaps with its own directory and
+	     * section after a colon.
+	     */
+	    if (num_formats == MAX_FORMATS)	usage();
+	    formats[num_formats].output = output;
+	    formats[num_formats].default_section = default_section;
+	    formats[num_formats].dir = NULL;
+	    formats[num_formats].section = NULL;
+	    if ((s = strchr(optarg, ':')))
+	    {
+		*s++ = '\0';
+		if (*s && *s != ':')	formats[num_formats].dir = s;
+		if ((s = strchr(s, ':')))
+		{
+		    *s++ = '\0';
+		    if (*s)	formats[num_formats].section = s;
+		}
+	    }
+	    num_formats++;
+
 	    s = strtok(&optarg[1], ",");
 	    if (s && *output->parse_option == NULL) usage();
 	    while(s)
@@ -853,14 +2522,93 @@ char **argv;
 	    body_start_only = TRUE;
             look_at_body_start = TRUE;
             break;
+	case 'j':
+	    if ((max_jobs = atoi(optarg)) < 1)	usage();
+	    break;
+	case 'N':
+	    if (!direct_input_option(optarg))	usage();
+	    break;
+	case 'Q':
+	    if (!read_typedef_catalog(optarg))	exit(1);
+	    /* FALLTHROUGH */
+	case 'q':
+	    skip_system_headers = TRUE;
+	    break;
+	case 'K':
+	    skim_declarations = FALSE;
+	    break;
+	case 'c':
+	    check_coverage = TRUE;
+	    coverage_threshold = atoi(optarg);
+	    if (coverage_threshold < 0 || coverage_threshold > 100)	usage();
+	    break;
+	case 'a':
+	    if ((max_batch = atoi(optarg)) < 1)	usage();
+	    break;
+	case 'C':
+	    cache_dir = optarg;
+	    break;
+	case 'm':
+	    use_manifest = TRUE;
+	    break;
+	case 'u':
+	    write_if_changed = TRUE;
+	    break;
+	case 'd':
+	    write_make_rules = TRUE;
+	    break;
+	case 'R':
+	    recurse_dirs = TRUE;
+	    break;
+	case 'f':
+	    include_input_pattern(optarg);
+	    break;
+	case 'X':
+	    exclude_input_pattern(optarg);
+	    break;
+	case 'w':
+	    watch_changes = TRUE;
+	    use_manifest = TRUE;
+	    break;
+	case 'z':
+	    if (!stats_option(optarg))	usage();
+	    break;
+	case 't':
+	    trace_name = optarg;
+	    break;
+	case 'E':
+	    if (!parse_date(optarg, &given_date))
+	    {
+		fprintf(stderr,"%s: bad date: %s\n", progname, optarg);
+		usage();
+	    }
+	    date_given = TRUE;
+	    clamp_date = FALSE;
+	    break;
+	case 'J':
+	    cpp_lookahead = atoi(optarg);
+	    if (cpp_lookahead < 0 || cpp_lookahead > MAX_LOOKAHEAD)	usage();
+	    break;
 	case '?':
 	default:
 	    usage();
 	}
     }
 
-    /* make sure we have a manual section */
-    if (manual_section == NULL)	manual_section = default_section;
+    /* with no -T, use the default format */
+    if (num_formats == 0)
+    {
+	formats[0].output = output;
+	formats[0].default_section = default_section;
+	formats[0].dir = NULL;
+	formats[0].section = NULL;
+	num_formats = 1;
+    }
+
+    /* cache entries and the manifest are only good while every file the
+     * preprocessor read is unchanged.
+     */
+    note_dependencies = cache_dir != NULL || use_manifest || write_make_rules;
 
 #ifdef MALLOC_DEBUG
     getchar();	/* wait so we can start up NeXT MallocDebug tool */
@@ -877,6 +2625,41 @@ char **argv;
     else
 	base_cpp_cmd = cpp_cmd;
 
+#ifdef SPAWN_CPP
+    /* the options go after the command, which may have options of its own */
+    add_words(&cpp_args, cpp_cmd);
+    for (i = 0; i < cpp_opt_args.argc; i++)
+	add_arg(&cpp_args, cpp_opt_args.argv[i]);
+    safe_free(cpp_opt_args.argv);
+
+    if (cpp_args.argc == 0)
+    {
+	fprintf(stderr,"%s: no preprocessor command\n", progname);
+	usage();
+    }
+#endif
+
+    for (i = optind; i < argc; ++i)
+	if (!add_input_name(argv[i]))
+	    exit(1);
+    input = input_names(&num_inputs);
+
+    if (watch_changes)
+    {
+	if (num_inputs == 0 || (output_dir && strcmp(output_dir, "-") == 0))
+	{
+	    fprintf(stderr,"%s: %s\n", progname,
+			"can only watch input files for output to files");
+	    usage();
+	}
+	if (!start_watching(input, num_inputs))
+	    exit(1);
+    }
+
+    start_stats();
+    if (trace_name && !start_trace(trace_name))
+	exit(1);
+
     if (optind == argc) {
 	if (use_input_name)
 	{
@@ -886,16 +2669,76 @@ char **argv;
 	}
 	ok = process_stdin(base_cpp_cmd);
     }    
+    else if (num_inputs == 0)
+    {
+	fprintf(stderr,"%s: no input files found\n", progname);
+	ok = 1;
+    }
+    else if ((use_manifest || write_make_rules) && !check_coverage &&
+			    !(output_dir && strcmp(output_dir, "-") == 0))
+    {
+	char **names = (char **)safe_malloc(num_inputs * sizeof *names);
+	int num = 0;
+
+	s = run_fingerprint(optind, argv, input, num_inputs);
+	open_manifest(s, input, num_inputs);
+	free(s);
+
+	for (i = 0; i < num_inputs; ++i)
+	    if (manifest_input_changed(input[i]))
+		names[num++] = input[i];
+
+	if (num > 0 && (ok = process_files(base_cpp_cmd, names, num)))
+	{
+	    ok = manifest_restore_pages();
+
+	    /* leave the base file as if we'd done them all */
+	    set_base_file(input[num_inputs - 1]);
+	}
+	else if (num == 0)
+	    ok = 1;
+	free(names);
+    }
     else
-	for (i = optind; i < argc; ++i)
-	    if (!(ok = process_file(base_cpp_cmd,argv[i])))	break;
+	ok = process_files(base_cpp_cmd, input, num_inputs);
+
+    if (ok && check_coverage)
+	ok = check_manual_pages(firstpage, coverage_threshold);
+    else if (ok && firstpage)
+    {
+	const char *section = manual_section;
+	char *dir = output_dir;
+
+	for (i = 0; i < num_formats; i++)
+	{
+	    output = formats[i].output;
+	    output_dir = formats[i].dir ? formats[i].dir : dir;
+
+	    /* make sure we have a manual section */
+	    manual_section = formats[i].section ? formats[i].section :
+			     section ? section : formats[i].default_section;
 
-    if (ok && firstpage)
-	output_manual_pages(firstpage,argc - optind, link_type);
+	    begin_alloc_category(ALLOC_OUTPUT);
+	    output_manual_pages(firstpage, num_inputs, link_type);
+	    end_alloc_category();
+	}
+	output_dir = dir;
+	manual_section = section;
+    }
+    ok = close_manifest(ok);
+    report_stats();
+    end_trace();
     free_manual_pages(firstpage);
     destroy_enum_lists();
+    free_input_names();
+    free_typedef_catalog();
 
     if (cpp_opts)	free((char *)base_cpp_cmd);
+#ifdef SPAWN_CPP
+    for (i = 0; i < cpp_args.argc; i++)
+	free(cpp_args.argv[i]);
+    safe_free(cpp_args.argv);
+#endif
 
     for (includefile = first_include; includefile;)
     {
@@ -921,8 +2764,48 @@ char **argv;
     malloc_dump(2);
     malloc_chain_check(1);
 #endif
+#ifdef MALLOC_STATS
+    report_malloc_stats();
+#endif
 #ifdef MALLOC_DEBUG
     sleep(1000000);
 #endif
     return !ok;
 }
+
+int
+main (argc, argv)
+int argc;
+char **argv;
+{
+#ifdef USE_SERVER
+    /* -Y and -y come first, since they say how everything else is run */
+    if (argc > 1 && argv[1][0] == '-' &&
+	(argv[1][1] == 'Y' || argv[1][1] == 'y'))
+    {
+	const char *socket_name = argv[1] + 2;
+	boolean serve = argv[1][1] == 'Y';
+	int shift = 2, status;
+
+	if (*socket_name == '\0')
+	{
+	    if (argc < 3)	usage();
+	    socket_name = argv[2];
+	    shift = 3;
+	}
+
+	/* what's left is a command line of its own */
+	argv[shift - 1] = argv[0];
+	argc -= shift - 1;
+	argv += shift - 1;
+
+	if (serve)
+	    return run_server(socket_name, argc, argv);
+
+	/* if there's no server, do it ourselves */
+	if ((status = run_client(socket_name, argc, argv)) != -1)
+	    return status;
+    }
+#endif
+    return run_c2man(argc, argv);
+}
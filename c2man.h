@@ -48,6 +48,14 @@
 #include </usr/local/debug_include/malloc.h>
 #endif
 
+/* count the allocations in each category, reporting them at the end */
+#ifdef MALLOC_STATS
+#include "memstats.h"
+#else
+#define begin_alloc_category(category)
+#define end_alloc_category()
+#endif
+
 #include "confmagic.h"
 
 /* number of spaces in a tab */
@@ -238,16 +246,34 @@ extern boolean terse_specified;
 extern boolean always_document_params;
 
 extern char *output_dir;
+extern char *cache_dir;
+extern boolean write_if_changed;
+extern boolean use_manifest;
+extern boolean write_make_rules;
+extern boolean recurse_dirs;
+extern boolean check_coverage;
+extern boolean skim_declarations;
+extern boolean verbose;
+
+/* the date to put on the pages, if given, and whether it's only the latest
+ * they may have.
+ */
+extern boolean date_given;
+extern Time_t given_date;
+extern boolean clamp_date;
 
 /* Global declarations */
 extern int line_num;
 extern const char *basefile;
 extern Time_t basetime;
 extern boolean inbasefile;
+extern boolean is_base_file _((const char *name));
 extern boolean header_file;
 extern SymbolTable *typedef_names;
 extern void output_error();
 extern void parse_file _((const char *start_file));
+extern boolean scan_mapped_file _((const char *name));
+extern const char *current_dir _((void));
 extern int errors;
 extern const char *manual_section;
 extern boolean use_input_name;
@@ -281,4 +307,7 @@ void my_perror _((const char *action, const char *filename));
 
 char *alloc_string _((const char *start, const char *end));
 
+/* run as if started with a command line */
+int run_c2man _((int argc, char **argv));
+
 #endif
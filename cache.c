@@ -0,0 +1,213 @@
+/* $Id$
+ *
+ * A cache of the preprocessor's output, kept in a directory between runs.
+ *
+ * Each entry is named after a hash of the input file's contents and of
+ * everything else that goes into running the preprocessor on it: the command
+ * and its options, the current directory, and any wrapper.  It starts with a
+ * header giving that text in full, and the device, inode, size and
+ * modification time of each file the preprocessor read, so a hit is only
+ * taken if nothing has changed since; the output follows.
+ */
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "c2man.h"
+#include "strconcat.h"
+#include "serial.h"
+#include "depend.h"
+#include "cache.h"
+
+#define CACHE_MAGIC	"c2man cache 1\n"
+
+/* the two 32 bit hashes a file is summed up by */
+typedef struct Hash
+{
+    unsigned long fnv, sdbm;
+} Hash;
+
+static void add_hash(h, s, len)
+Hash *h;
+const char *s;
+size_t len;
+{
+    const unsigned char *p = (const unsigned char *)s;
+
+    while (len--)
+    {
+	h->fnv = ((h->fnv ^ *p) * 16777619UL) & 0xFFFFFFFFUL;
+	h->sdbm = (h->sdbm * 65599UL + *p++) & 0xFFFFFFFFUL;
+    }
+}
+
+static void start_hash(h, key)
+Hash *h;
+const char *key;
+{
+    h->fnv = 2166136261UL;
+    h->sdbm = 0;
+    add_hash(h, key, strlen(key) + 1);
+}
+
+char *hash_file(name, key)
+const char *name;
+const char *key;
+{
+    Hash h;
+    FILE *f;
+    char buf[BUFSIZ];
+    size_t n;
+
+    if ((f = fopen(name, "r")) == NULL)
+	return NULL;
+
+    start_hash(&h, key);
+    while ((n = fread(buf, 1, sizeof buf, f)) > 0)
+	add_hash(&h, buf, n);
+
+    if (ferror(f))
+    {
+	fclose(f);
+	return NULL;
+    }
+    fclose(f);
+
+    sprintf(buf, "%08lx%08lx", h.fnv, h.sdbm);
+    return strduplicate(buf);
+}
+
+char *cache_entry(name, key)
+const char *name;
+const char *key;
+{
+    char *hash, *entry;
+
+    if ((hash = hash_file(name, key)) == NULL)
+	return NULL;
+
+    entry = strconcat(cache_dir, "/", hash, NULLCP);
+    free(hash);
+    return entry;
+}
+
+char *cache_key_entry(key)
+const char *key;
+{
+    Hash h;
+    char buf[20];
+
+    start_hash(&h, key);
+    sprintf(buf, "%08lx%08lx", h.fnv, h.sdbm);
+    return strconcat(cache_dir, "/", buf, NULLCP);
+}
+
+FILE *cache_lookup(entry, key)
+const char *entry;
+const char *key;
+{
+    FILE *f;
+    char magic[sizeof CACHE_MAGIC], *old_key;
+    boolean ok, changed;
+
+    if ((f = fopen(entry, "r")) == NULL)
+	return NULL;
+
+    ok = fgets(magic, sizeof magic, f) && strcmp(magic, CACHE_MAGIC) == 0 &&
+	read_string(f, &old_key) && old_key != NULL;
+
+    /* the hash could collide, so the key must match in full */
+    if (ok)
+    {
+	ok = strcmp(old_key, key) == 0;
+	free(old_key);
+    }
+
+    if (ok)
+	ok = read_dependencies(f, &changed) && !changed;
+
+    if (!ok)
+    {
+	fclose(f);
+	return NULL;
+    }
+
+    return f;
+}
+
+/* write an entry's header, and copy the output after it */
+static boolean write_entry(f, key, output)
+FILE *f;
+const char *key;
+FILE *output;
+{
+    char buf[BUFSIZ];
+    size_t n;
+
+    fputs(CACHE_MAGIC, f);
+    write_string(f, key);
+    write_dependencies(f);
+
+    rewind(output);
+    while ((n = fread(buf, 1, sizeof buf, output)) > 0)
+	if (fwrite(buf, 1, n, f) != n)
+	    return FALSE;
+
+    return !ferror(output) && !ferror(f);
+}
+
+FILE *cache_create(entry, temp_name)
+const char *entry;
+char **temp_name;
+{
+    char buf[20];
+    FILE *f;
+
+    /* write it under a name of our own, to rename into place when done */
+    sprintf(buf, ".%ld", (long)getpid());
+    *temp_name = strconcat(entry, buf, NULLCP);
+
+    if ((f = fopen(*temp_name, "w")) == NULL && errno == ENOENT &&
+	mkdir(cache_dir, 0777) == 0)
+	f = fopen(*temp_name, "w");
+
+    if (f == NULL)
+    {
+	my_perror("can't write cache entry", *temp_name);
+	free(*temp_name);
+	*temp_name = NULL;
+    }
+    return f;
+}
+
+boolean cache_commit(f, entry, temp_name, ok)
+FILE *f;
+const char *entry;
+char *temp_name;
+boolean ok;
+{
+    if (fclose(f) == EOF)	ok = FALSE;
+
+    if (!ok || rename(temp_name, entry) != 0)
+    {
+	my_perror("error writing cache entry", temp_name);
+	unlink(temp_name);
+	ok = FALSE;
+    }
+
+    free(temp_name);
+    return ok;
+}
+
+boolean cache_store(entry, key, output)
+const char *entry;
+const char *key;
+FILE *output;
+{
+    char *temp_name;
+    FILE *f;
+
+    if ((f = cache_create(entry, &temp_name)) == NULL)
+	return FALSE;
+
+    return cache_commit(f, entry, temp_name, write_entry(f, key, output));
+}
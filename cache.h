@@ -0,0 +1,49 @@
+/* $Id$
+ * cache the preprocessor's output between runs
+ */
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "c2man.h"
+
+/* hash the contents of a file, after some other text.
+ * Returns a malloc'ed string of hex digits, or NULL if the file can't be read.
+ */
+char *hash_file _((const char *name, const char *key));
+
+/* the name of the cache entry for the preprocessor's output on a file, given
+ * the text of everything besides the files it reads that the output depends
+ * on.  Returns a malloc'ed name, or NULL if the file can't be read.
+ */
+char *cache_entry _((const char *name, const char *key));
+
+/* the name of the cache entry for something that depends on nothing but the
+ * text of its key.  Returns a malloc'ed name.
+ */
+char *cache_key_entry _((const char *key));
+
+/* open a cache entry, if it's there and every file noted in it is unchanged.
+ * Returns a stream positioned at the cached output, or NULL if there's none.
+ */
+FILE *cache_lookup _((const char *entry, const char *key));
+
+/* store the preprocessor's output in a cache entry, along with the
+ * dependencies noted while parsing it.  The entry appears all at once, so
+ * other processes sharing the cache never see it half written.
+ * Returns FALSE in the event of failure.
+ */
+boolean cache_store _((const char *entry, const char *key, FILE *output));
+
+/* start writing a new cache entry, under a temporary name that's set.
+ * Returns NULL in the event of failure.
+ */
+FILE *cache_create _((const char *entry, char **temp_name));
+
+/* finish writing a new cache entry, and if ok says it was all written, move
+ * it into place.  The temporary name is freed.
+ * Returns FALSE in the event of failure.
+ */
+boolean cache_commit _((FILE *f, const char *entry, char *temp_name,
+								boolean ok));
+
+#endif
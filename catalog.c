@@ -0,0 +1,126 @@
+/* $Id$
+ *
+ * Stand in for the system headers with a catalog of the type names they
+ * define.  All we need from <stdio.h> and the like is to know that FILE or
+ * size_t names a type, so when the scanner reads files itself it can skip
+ * them, which is most of the work for a small header, and take the names from
+ * here instead.  The names are added only once a system header has been
+ * skipped, as that's where they'd have come from.
+ *
+ * The catalog holds the types of standard C and POSIX; the user can add
+ * others from files listing them.
+ */
+#include "c2man.h"
+#include "catalog.h"
+
+#include <ctype.h>
+
+boolean skip_system_headers = FALSE;
+
+static const char *standard_typedefs[] =
+{
+    /* ISO C */
+    "size_t", "ptrdiff_t", "wchar_t", "wint_t", "wctype_t", "wctrans_t",
+    "mbstate_t", "max_align_t", "char16_t", "char32_t",
+    "FILE", "fpos_t", "va_list", "jmp_buf", "sig_atomic_t",
+    "time_t", "clock_t", "div_t", "ldiv_t", "lldiv_t",
+    "float_t", "double_t", "fenv_t", "fexcept_t",
+    "int8_t", "int16_t", "int32_t", "int64_t",
+    "uint8_t", "uint16_t", "uint32_t", "uint64_t",
+    "int_least8_t", "int_least16_t", "int_least32_t", "int_least64_t",
+    "uint_least8_t", "uint_least16_t", "uint_least32_t", "uint_least64_t",
+    "int_fast8_t", "int_fast16_t", "int_fast32_t", "int_fast64_t",
+    "uint_fast8_t", "uint_fast16_t", "uint_fast32_t", "uint_fast64_t",
+    "intptr_t", "uintptr_t", "intmax_t", "uintmax_t", "bool",
+
+    /* POSIX */
+    "ssize_t", "off_t", "pid_t", "uid_t", "gid_t", "id_t", "mode_t",
+    "dev_t", "ino_t", "nlink_t", "blksize_t", "blkcnt_t", "fsblkcnt_t",
+    "fsfilcnt_t", "key_t", "useconds_t", "suseconds_t", "clockid_t",
+    "timer_t", "locale_t", "sigset_t", "sigjmp_buf", "siginfo_t",
+    "stack_t", "fd_set", "nfds_t", "rlim_t", "DIR", "socklen_t",
+    "sa_family_t", "in_addr_t", "in_port_t", "tcflag_t", "cc_t", "speed_t",
+    "regex_t", "regmatch_t", "regoff_t", "glob_t", "iconv_t", "nl_item",
+    "nl_catd", "wordexp_t", "posix_spawnattr_t", "posix_spawn_file_actions_t",
+    "pthread_t", "pthread_attr_t", "pthread_key_t", "pthread_once_t",
+    "pthread_mutex_t", "pthread_mutexattr_t", "pthread_cond_t",
+    "pthread_condattr_t", "pthread_rwlock_t", "pthread_rwlockattr_t",
+    "pthread_spinlock_t", "pthread_barrier_t", "pthread_barrierattr_t",
+    "sem_t", "mqd_t", "caddr_t",
+    NULL
+};
+
+/* the names added by the user */
+static char **user_typedefs = NULL;
+static int num_user_typedefs = 0, max_user_typedefs = 0;
+
+static void add_user_typedef(name)
+const char *name;
+{
+    if (num_user_typedefs == max_user_typedefs)
+    {
+	max_user_typedefs = max_user_typedefs ? max_user_typedefs * 2 : 16;
+	if (user_typedefs == NULL)
+	    user_typedefs = (char **)safe_malloc(
+				max_user_typedefs * sizeof *user_typedefs);
+	else if ((user_typedefs = (char **)realloc(user_typedefs,
+			max_user_typedefs * sizeof *user_typedefs)) == NULL)
+	    outmem();
+    }
+    user_typedefs[num_user_typedefs++] = strduplicate(name);
+}
+
+boolean read_typedef_catalog(name)
+const char *name;
+{
+    FILE *f;
+    char buf[MAX_TEXT_LENGTH], *s, *end;
+    boolean ok;
+
+    if ((f = fopen(name, "r")) == NULL)
+    {
+	my_perror("can't read type names from", name);
+	return FALSE;
+    }
+
+    /* a name to a line, with anything after a # ignored */
+    while (fgets(buf, sizeof buf, f) != NULL)
+    {
+	if ((s = strchr(buf, '#')) != NULL)
+	    *s = '\0';
+	for (s = buf; isspace((unsigned char)*s); s++)
+	    ;
+	for (end = s; *end && !isspace((unsigned char)*end); end++)
+	    ;
+	*end = '\0';
+
+	if (*s)
+	    add_user_typedef(s);
+    }
+
+    if ((ok = !ferror(f)) == FALSE)
+	my_perror("error reading type names from", name);
+    fclose(f);
+    return ok;
+}
+
+void add_catalog_typedefs(table)
+SymbolTable *table;
+{
+    int i;
+
+    for (i = 0; standard_typedefs[i]; i++)
+	new_symbol(table, (char *)standard_typedefs[i], DS_NONE);
+    for (i = 0; i < num_user_typedefs; i++)
+	new_symbol(table, user_typedefs[i], DS_NONE);
+}
+
+void free_typedef_catalog()
+{
+    int i;
+
+    for (i = 0; i < num_user_typedefs; i++)
+	free(user_typedefs[i]);
+    safe_free(user_typedefs);
+    num_user_typedefs = max_user_typedefs = 0;
+}
@@ -0,0 +1,27 @@
+/* $Id$
+ * stand in for the system headers with a catalog of the type names they
+ * define
+ */
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include "c2man.h"
+#include "symbol.h"
+
+/* should the scanner skip #include <file> when reading files itself? */
+extern boolean skip_system_headers;
+
+/* add the type names listed in a file, one to a line, to the catalog.
+ * Returns FALSE in the event of failure.
+ */
+boolean read_typedef_catalog _((const char *name));
+
+/* make every name in the catalog a type name, in place of the system header
+ * that would have defined it.
+ */
+void add_catalog_typedefs _((SymbolTable *table));
+
+/* forget the names added to the catalog */
+void free_typedef_catalog _((void));
+
+#endif
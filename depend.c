@@ -0,0 +1,271 @@
+/* $Id$
+ *
+ * Keep a list of the files the preprocessor reads for each input file, as
+ * named in its line directives, so we can tell later whether its output
+ * could have changed.
+ */
+#include <sys/stat.h>
+
+#include "c2man.h"
+#include "symbol.h"
+#include "depend.h"
+
+/* the files in the order first seen, with their stamps, and a table to spot
+ * repeats quickly
+ */
+static char **dep_names;
+static FileStamp *dep_stamps;
+static int num_deps = 0, max_deps = 0;
+static SymbolTable *dep_table = NULL;
+
+/* when the files started to be read, if we know */
+static boolean since_known = FALSE;
+static long read_since;
+
+/* the mtime given a file modified after it started to be read */
+#define UNSETTLED	(-1L)
+
+void clear_dependencies()
+{
+    if (dep_table)
+    {
+	destroy_symbol_table(dep_table);
+	dep_table = NULL;
+    }
+    num_deps = 0;
+    since_known = FALSE;
+}
+
+void dependencies_read_since(when)
+Time_t when;
+{
+    since_known = TRUE;
+    read_since = (long)when;
+}
+
+/* make room for a file not seen before, returning where its stamp goes, or
+ * NULL if it's to be ignored.
+ */
+static FileStamp *new_dependency(name)
+const char *name;
+{
+    Symbol *sym;
+
+    /* skip the standard input, and the likes of <built-in> */
+    if (name == NULL || *name == '\0' || *name == '<')
+	return NULL;
+
+    if (dep_table == NULL)
+	dep_table = create_symbol_table();
+    else if (find_symbol(dep_table, (char *)name))
+	return NULL;
+
+    sym = new_symbol(dep_table, (char *)name, 0);
+
+    if (num_deps == max_deps)
+    {
+	max_deps = max_deps ? max_deps * 2 : 32;
+	if (dep_names == NULL)
+	{
+	    dep_names = (char **)safe_malloc(max_deps * sizeof *dep_names);
+	    dep_stamps = (FileStamp *)safe_malloc(
+					    max_deps * sizeof *dep_stamps);
+	}
+	else if ((dep_names = (char **)realloc(dep_names,
+				max_deps * sizeof *dep_names)) == NULL ||
+		 (dep_stamps = (FileStamp *)realloc(dep_stamps,
+				max_deps * sizeof *dep_stamps)) == NULL)
+	    outmem();
+    }
+
+    /* the table owns the name */
+    dep_names[num_deps] = sym->name;
+    return &dep_stamps[num_deps++];
+}
+
+/* take a file's stamp, with a size of -1 if it can't be stat'ed */
+static void take_stamp(name, stamp)
+const char *name;
+FileStamp *stamp;
+{
+    struct stat statbuf;
+
+    if (stat(name, &statbuf) != 0)
+    {
+	memset((char *)stamp, 0, sizeof *stamp);
+	stamp->size = -1;
+	return;
+    }
+    stamp->dev = (unsigned long)statbuf.st_dev;
+    stamp->ino = (unsigned long)statbuf.st_ino;
+    stamp->size = (long)statbuf.st_size;
+    stamp->mtime = (long)statbuf.st_mtime;
+}
+
+void add_dependency(name)
+const char *name;
+{
+    FileStamp *stamp = new_dependency(name);
+
+    if (stamp == NULL)
+	return;
+
+    /* one modified in the same second as the reading started counts, since
+     * the change could have come just after.
+     */
+    take_stamp(name, stamp);
+    if (since_known && stamp->size != -1 && stamp->mtime >= read_since)
+	stamp->mtime = UNSETTLED;
+}
+
+void add_stamped_dependency(name, stamp)
+const char *name;
+const FileStamp *stamp;
+{
+    FileStamp *new_stamp = new_dependency(name);
+
+    if (new_stamp)
+	*new_stamp = *stamp;
+}
+
+int num_dependencies()
+{
+    return num_deps;
+}
+
+const char *dependency(i)
+int i;
+{
+    return dep_names[i];
+}
+
+const FileStamp *dependency_stamp(i)
+int i;
+{
+    return &dep_stamps[i];
+}
+
+boolean dependencies_settled()
+{
+    int i;
+
+    for (i = 0; i < num_deps; i++)
+	if (dep_stamps[i].size != -1 && dep_stamps[i].mtime == UNSETTLED)
+	    return FALSE;
+    return TRUE;
+}
+
+/* each file is written as its device, inode, size and modification time,
+ * then its name as its length, a colon, the characters themselves and a
+ * newline.
+ */
+static void put_file_stamp(f, name, stamp)
+FILE *f;
+const char *name;
+const FileStamp *stamp;
+{
+    fprintf(f, "%lu %lu %ld %ld %lu:%s\n", stamp->dev, stamp->ino,
+	    stamp->size, stamp->mtime, (unsigned long)strlen(name), name);
+}
+
+boolean write_file_stamp(f, name)
+FILE *f;
+const char *name;
+{
+    FileStamp stamp;
+
+    take_stamp(name, &stamp);
+    if (stamp.size == -1)
+	return FALSE;
+
+    put_file_stamp(f, name, &stamp);
+    return TRUE;
+}
+
+char *read_file_stamp(f, stamp)
+FILE *f;
+FileStamp *stamp;
+{
+    unsigned long len;
+    char *name;
+
+    if (fscanf(f, "%lu %lu %ld %ld %lu:", &stamp->dev, &stamp->ino,
+			&stamp->size, &stamp->mtime, &len) != 5)
+	return NULL;
+
+    name = (char *)safe_malloc((size_t)len + 1);
+    if (fread(name, 1, (size_t)len, f) != len || getc(f) != '\n')
+    {
+	free(name);
+	return NULL;
+    }
+    name[len] = '\0';
+    return name;
+}
+
+boolean file_changed(name, stamp)
+const char *name;
+const FileStamp *stamp;
+{
+    struct stat statbuf;
+
+    return stat(name, &statbuf) != 0 ||
+	(unsigned long)statbuf.st_dev != stamp->dev ||
+	(unsigned long)statbuf.st_ino != stamp->ino ||
+	(long)statbuf.st_size != stamp->size ||
+	(long)statbuf.st_mtime != stamp->mtime;
+}
+
+boolean touched_since(name, when)
+const char *name;
+Time_t when;
+{
+    struct stat statbuf;
+
+    return stat(name, &statbuf) == 0 && (long)statbuf.st_mtime >= (long)when;
+}
+
+/* the stamps written are those taken when the files were first noted, not
+ * now, so a file changed since still looks changed next time.
+ */
+void write_dependencies(f)
+FILE *f;
+{
+    int num, i;
+
+    for (num = i = 0; i < num_deps; i++)
+	if (dep_stamps[i].size != -1)
+	    num++;
+    fprintf(f, "%d\n", num);
+
+    for (i = 0; i < num_deps; i++)
+	if (dep_stamps[i].size != -1)
+	    put_file_stamp(f, dep_names[i], &dep_stamps[i]);
+}
+
+boolean read_dependencies(f, changed)
+FILE *f;
+boolean *changed;
+{
+    FileStamp stamp;
+    char *name;
+    int num, i;
+
+    clear_dependencies();
+    *changed = FALSE;
+
+    if (fscanf(f, "%d", &num) != 1 || getc(f) != '\n')
+	return FALSE;
+
+    for (i = 0; i < num; i++)
+    {
+	if ((name = read_file_stamp(f, &stamp)) == NULL)
+	    return FALSE;
+	if (file_changed(name, &stamp))
+	    *changed = TRUE;
+
+	add_stamped_dependency(name, &stamp);
+	free(name);
+    }
+    return TRUE;
+}
@@ -0,0 +1,76 @@
+/* $Id$
+ * keep track of the files the preprocessor reads for each input file
+ */
+#ifndef DEPEND_H
+#define DEPEND_H
+
+#include "c2man.h"
+
+/* a file's device, inode, size and modification time, to tell later if it
+ * has changed
+ */
+typedef struct FileStamp
+{
+    unsigned long dev, ino;
+    long size, mtime;
+} FileStamp;
+
+/* forget the files noted so far, to start on another input file */
+void clear_dependencies _((void));
+
+/* say when the files for the input started to be read, before the
+ * preprocessor was run.  A file modified since may have been read as it was
+ * before or after, so its stamp is one that never matches, and it's taken to
+ * have changed next time.
+ */
+void dependencies_read_since _((Time_t when));
+
+/* note that the preprocessor read a file, as named in a line directive, and
+ * take its stamp.  Names it makes up for itself, like <built-in>, are
+ * ignored, as are repeats.
+ */
+void add_dependency _((const char *name));
+
+/* note a file with a stamp taken before, as from dependency_stamp */
+void add_stamped_dependency _((const char *name, const FileStamp *stamp));
+
+/* the number of files noted, and each in the order they were first seen,
+ * with its stamp as it was then; the size is -1 for one that couldn't be
+ * stat'ed.
+ */
+int num_dependencies _((void));
+const char *dependency _((int i));
+const FileStamp *dependency_stamp _((int i));
+
+/* can the stamps of all the files noted be trusted? */
+boolean dependencies_settled _((void));
+
+/* write a file's stamp, and its name, to a stream.
+ * Returns FALSE if it can't be stat'ed, when nothing is written.
+ */
+boolean write_file_stamp _((FILE *f, const char *name));
+
+/* read back a file's stamp written by write_file_stamp.
+ * Returns its malloc'ed name, or NULL if the stream is corrupt.
+ */
+char *read_file_stamp _((FILE *f, FileStamp *stamp));
+
+/* has a file changed since its stamp was taken? */
+boolean file_changed _((const char *name, const FileStamp *stamp));
+
+/* has a file been modified since (or in the same second as) a time? */
+boolean touched_since _((const char *name, Time_t when));
+
+/* write the files noted to a stream, each with its stamp, so
+ * read_dependencies can tell later if any has changed.  Those that couldn't
+ * be stat'ed are left out.
+ */
+void write_dependencies _((FILE *f));
+
+/* read back a list written by write_dependencies in place of the files noted
+ * so far, with the stamps written, setting changed if any of them has changed
+ * since.  Returns FALSE if the stream is corrupt.
+ */
+boolean read_dependencies _((FILE *f, boolean *changed));
+
+#endif
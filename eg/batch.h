@@ -0,0 +1,4 @@
+/* batch - includes dash.h, which -a then meets again in the same batch */
+#include "dash.h"
+
+int batch(int x);
@@ -0,0 +1,21 @@
+/*
+ * Add two numbers.
+ * Returns their sum.
+ */
+int add(a, b)
+int a;	/* the first number */
+int b;	/* the second number */
+{
+    return a + b;
+}
+
+int undocumented(x)
+int x;
+{
+    return x;
+}
+
+/* Print a number, without saying what the number is. */
+void print_number(int number)
+{
+}
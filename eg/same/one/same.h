@@ -0,0 +1,4 @@
+/* one of two headers of the same name, in different directories */
+
+/* Say whether a number is one. */
+extern int is_one(int n);
@@ -0,0 +1,4 @@
+/* the other header of the same name */
+
+/* Say whether two numbers are the same. */
+extern int same(int a, int b);
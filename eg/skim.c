@@ -0,0 +1,28 @@
+#include "skim.h"
+
+/*
+ * Count one colour in a tally.
+ * Returns the count of that colour so far.
+ */
+Count count_colour(
+    struct tally *tally,	/* the tally to count it in */
+    Colour colour		/* the colour to count */
+)
+{
+    return ++tally->counts[colour];
+}
+
+/*
+ * Total the tallies.
+ * Returns the number of everything counted.
+ */
+Count total(void)
+{
+    Count sum = 0;
+    int i;
+
+    for (i = 0; i < num_tallies; i++)
+	sum = add_counts(sum, tallies[i].counts[RED] +
+		tallies[i].counts[GREEN] + tallies[i].counts[BLUE]);
+    return sum;
+}
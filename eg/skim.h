@@ -0,0 +1,25 @@
+/* declarations for skim.c; c2man passes over most of these unparsed */
+typedef unsigned long Count;
+
+enum colour { RED, GREEN, BLUE };
+
+struct tally
+{
+    Count counts[3];
+};
+
+extern int num_tallies;
+extern struct tally *tallies;
+
+extern Count add_counts(Count a, Count b);
+extern void clear_tally(struct tally *tally) __attribute__((nonnull));
+
+static int twice(x)
+int x;
+{
+    return x * 2;
+}
+
+typedef enum colour Colour;
+
+extern int (*on_change)(struct tally *tally, Colour colour);
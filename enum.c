@@ -5,6 +5,7 @@
 #include "strconcat.h"
 #include "enum.h"
 #include "manpage.h"
+#include "snapshot.h"
 
 SymbolTable *enum_table;	/* enum symbol table */
 
@@ -24,12 +25,14 @@ new_enumerator_list (enumerator)
     Enumerator *p;
     EnumeratorList *list;
     
+    begin_alloc_category(ALLOC_ENUMS);
     list = (EnumeratorList *)safe_malloc(sizeof *list);
     *last_next_list = list;
     last_next_list = &list->next;
     list->next = NULL;
     
     p = (Enumerator *)safe_malloc(sizeof(Enumerator));
+    end_alloc_category();
     *p = *enumerator;
     
     list->first = list->last = p;
@@ -45,7 +48,9 @@ add_enumerator_list (list, enumerator)
 {
     Enumerator *p;
 
+    begin_alloc_category(ALLOC_ENUMS);
     p = (Enumerator *)safe_malloc((unsigned)sizeof(Enumerator));
+    end_alloc_category();
     *p = *enumerator;
 
     list->last->next = p;
@@ -126,6 +131,7 @@ void add_enum_symbol(name, enum_list)
 	entry->value.enum_list = enum_list;
 	entry->valtype = SYMVAL_ENUM;
     }
+    note_enum_symbol(name, enum_list);
 }
 
 /* look for the Enumerator list associated with the symbol */
@@ -169,6 +175,7 @@ void new_typedef_symbols(decl_spec, decl_list)
 	    s->value.enum_list = decl_spec->enum_list;
 	    s->valtype = SYMVAL_ENUM;
 	}
+	note_typedef_symbol(d->name, DS_NONE, decl_spec->enum_list);
     }
 }
 
@@ -41,6 +41,9 @@
 /* text inside a regular comment, and one at the end of a non-empty line */
 %token T_COMMENT T_EOLCOMMENT
 
+/* boundary between input files preprocessed together in a batch */
+%token T_BATCH_BREAK
+
 %type <declaration> declaration
 %type <parameter> function_definition
 %type <decl_spec> declaration_specifiers declaration_specifier
@@ -70,6 +73,11 @@
 #include "strappend.h"
 #include "manpage.h"
 #include "enum.h"
+#include "stats.h"
+#include "trace.h"
+#include "catalog.h"
+#include "mapfile.h"
+#include "snapshot.h"
 
 #ifdef I_STDARG
 #include <stdarg.h>
@@ -80,6 +88,13 @@
 
 int yylex();
 
+/* the parser gets its tokens through a wrapper that counts them, and
+ * another that drops declarations outside the base file which it doesn't need.
+ */
+static int counted_yylex _((void));
+static int skimming_yylex _((void));
+#define yylex skimming_yylex
+
 #define YYMAXDEPTH 150
 
 /* where are we up to scanning through an enum? */
@@ -121,6 +136,9 @@ external_declaration
 				/* Use the body comment */
 	      new_manual_page(body_comment,&$1.decl_spec,$1.declarator);
 	      body_comment = NULL; /* Prevent it being free'ed */
+	    } else if (check_coverage) {
+				/* Keep it to report it as undocumented */
+	      new_manual_page(NULL,&$1.decl_spec,$1.declarator);
 	    } else {
 	      free_declarator($1.declarator);
 	      free_decl_spec(&$1.decl_spec);
@@ -132,6 +150,9 @@ external_declaration
 	      if (body_comment) {
 		new_manual_page(body_comment,&$2.decl_spec,$2.declarator);
 		body_comment = NULL; /* Prevent it being free'ed */
+	      } else if (check_coverage) {
+		new_manual_page(NULL,&$2.decl_spec,$2.declarator);
+		safe_free($1);
 	      } else {
 		free_declarator($2.declarator);
 		free_decl_spec(&$2.decl_spec);
@@ -147,6 +168,8 @@ external_declaration
 	    if (look_at_body_start && body_comment) {
 	      new_manual_page(body_comment,&$1.decl_spec,$1.declarator);
 	      body_comment = NULL; /* Prevent it being free'ed */
+	    } else if (check_coverage) {
+	      new_manual_page(NULL,&$1.decl_spec,$1.declarator);
 	    } else {
 	      free_declarator($1.declarator);
 	      free_decl_spec(&$1.decl_spec);
@@ -159,6 +182,9 @@ external_declaration
 	      if (body_comment) {
 		new_manual_page(body_comment,&$2.decl_spec,$2.declarator);
 		body_comment = NULL; /* Prevent it being free'ed */
+	      } else if (check_coverage) {
+		new_manual_page(NULL,&$2.decl_spec,$2.declarator);
+		safe_free($1);
 	      } else {
 		free_declarator($2.declarator);
 		free_decl_spec(&$2.decl_spec);
@@ -188,6 +214,12 @@ external_declaration
 	{
 	    free($1);
 	}
+	| T_BATCH_BREAK
+	{
+	    /* nothing to do; it just makes us finish off the previous file's
+	     * declarations before the scanner moves on to the next one.
+	     */
+	}
 	| error ';'
 	{
 	    yyerrok;
@@ -871,6 +903,8 @@ opt_eolcomment
 	;
 
 %%
+#undef yylex
+
 #ifdef MSDOS
 #include "lex_yy.c"
 #else
@@ -881,6 +915,207 @@ opt_eolcomment
 #endif /* !VMS   */
 #endif /* !MSDOS */
 
+/* get a token, charging the time to the scanner */
+static int counted_yylex()
+{
+    int token;
+
+    if (!keep_stats)
+	return yylex();
+
+    stats_enter(PHASE_SCAN);
+    token = yylex();
+    stats_leave();
+    stats_count(COUNT_TOKENS, 1L);
+    return token;
+}
+
+/* Outside the base file, all the parser needs from a declaration is any
+ * type names or enums it defines; the rest would only be built into
+ * declarators for new_manual_page to throw away.  So there we read ahead
+ * through each declaration, and drop it unless it turns out to hold a typedef
+ * or an enum, or runs back into the base file, when the parser is given the
+ * lot.
+ */
+typedef struct
+{
+    int token;
+    YYSTYPE value;
+} SkimmedToken;
+
+static SkimmedToken *skimmed = NULL;	/* the declaration read ahead */
+static int num_skimmed = 0, max_skimmed = 0;
+static int next_skimmed = 0;		/* next one to give the parser */
+
+static boolean decl_start;	/* is the next token the first of a declaration
+				 * after one that ended outside the base file?
+				 */
+static int decl_parens;		/* depth of parentheses in the declaration */
+static int decl_last;		/* previous token in the declaration */
+static boolean decl_old_style;	/* in old style parameter declarations? */
+
+/* throw away the tokens read ahead but not yet given to the parser */
+static void drop_skimmed()
+{
+    int i;
+
+    for (i = next_skimmed; i < num_skimmed; i++)
+	if (skimmed[i].token == T_IDENTIFIER ||
+	    skimmed[i].token == T_TYPEDEF_NAME ||
+	    skimmed[i].token == T_BRACKETS)
+	    free(skimmed[i].value.text);
+    num_skimmed = next_skimmed = 0;
+}
+
+/* start afresh at the beginning of a file */
+static void reset_skimming()
+{
+    drop_skimmed();
+    decl_start = TRUE;
+    decl_parens = 0;
+    decl_last = ';';
+    decl_old_style = FALSE;
+}
+
+/* can a token start the declaration of a parameter of an old style function
+ * definition?
+ */
+static boolean starts_parameter_declaration(token)
+int token;
+{
+    switch (token)
+    {
+    case T_TYPEDEF_NAME:
+    case T_CHAR: case T_DOUBLE: case T_FLOAT: case T_INT: case T_VOID:
+    case T_LONG: case T_SHORT: case T_SIGNED: case T_UNSIGNED:
+    case T_ENUM: case T_STRUCT: case T_UNION:
+    case T_CONST: case T_VOLATILE: case T_REGISTER:
+	return TRUE;
+    default:
+	return FALSE;
+    }
+}
+
+/* follow a token through a declaration; returns TRUE if it ends one */
+static boolean ends_declaration(token)
+int token;
+{
+    boolean end = FALSE;
+
+    switch (token)
+    {
+    case '(':
+	decl_parens++;
+	break;
+    case ')':
+	if (decl_parens > 0)	decl_parens--;
+	break;
+    case ';':
+	end = decl_parens == 0 && !decl_old_style;
+	break;
+    case T_BRACES:
+	/* a function body, or a block of extern "C" declarations */
+	end = decl_parens == 0 &&
+		(decl_last == ')' || decl_last == T_STRING_LITERAL ||
+		 (decl_old_style && decl_last == ';'));
+	break;
+    case T_COMMENT:
+    case T_EOLCOMMENT:
+	return FALSE;
+    case T_BATCH_BREAK:
+    case 0:
+	end = TRUE;
+	break;
+    }
+
+    /* a type after a parameter list starts the declarations of the parameters
+     * of an old style function definition; anything else, such as a macro
+     * for an attribute, is more of the same declaration, which ends at the
+     * next semicolon.
+     */
+    if (decl_parens == 0 && decl_last == ')' &&
+	starts_parameter_declaration(token))
+	decl_old_style = TRUE;
+
+    if (end)
+    {
+	decl_parens = 0;
+	decl_old_style = FALSE;
+	decl_last = ';';
+    }
+    else
+	decl_last = token;
+    return end;
+}
+
+/* hang on to a token read ahead */
+static void add_skimmed(token)
+int token;
+{
+    if (num_skimmed == max_skimmed)
+    {
+	max_skimmed = max_skimmed ? max_skimmed * 2 : 64;
+	if (skimmed == NULL)
+	    skimmed = (SkimmedToken *)safe_malloc(
+					max_skimmed * sizeof *skimmed);
+	else if ((skimmed = (SkimmedToken *)realloc(skimmed,
+					max_skimmed * sizeof *skimmed)) == NULL)
+	    outmem();
+    }
+    skimmed[num_skimmed].token = token;
+    skimmed[num_skimmed++].value = yylval;
+}
+
+/* get a token, dropping declarations outside the base file we've no use for */
+static int skimming_yylex()
+{
+    int token;
+    boolean end;
+
+    /* give the parser what was read ahead and kept */
+    if (next_skimmed < num_skimmed)
+    {
+	token = skimmed[next_skimmed].token;
+	yylval = skimmed[next_skimmed++].value;
+	if (next_skimmed == num_skimmed)
+	    num_skimmed = next_skimmed = 0;
+	return token;
+    }
+
+    for (;;)
+    {
+	token = counted_yylex();
+	end = ends_declaration(token);
+
+	if (num_skimmed == 0 &&
+	    (inbasefile || !decl_start || !skim_declarations))
+	    break;
+
+	/* these the parser needs to see */
+	if (inbasefile || token == T_TYPEDEF || token == T_ENUM ||
+	    token == T_COMMENT || token == T_EOLCOMMENT ||
+	    token == T_BATCH_BREAK || token == 0)
+	{
+	    if (num_skimmed == 0)
+		break;
+	    add_skimmed(token);
+	    decl_start = end && !inbasefile;
+	    return skimming_yylex();
+	}
+
+	add_skimmed(token);
+	if (end)
+	    drop_skimmed();
+    }
+
+    /* the parser has this token now, perhaps as lookahead, so we mustn't
+     * skim what it belongs to; only once a declaration has ended outside the
+     * base file can the next one be read ahead.
+     */
+    decl_start = end && !inbasefile;
+    return token;
+}
+
 #ifdef I_STDARG
 void yyerror(const char *format, ...)
 #else
@@ -913,6 +1148,8 @@ parse_file (start_file)
 const char *start_file;
 {
     const char *s;
+    const char *name = basefile ? basefile : "stdin";
+    double started;
 #ifdef FLEX_SCANNER
     static boolean restart = FALSE;
 #endif
@@ -930,15 +1167,31 @@ const char *start_file;
 
     line_num = 1;
     ly_count = 0;
+    reset_skimming();
     first_comment = group_together && !terse_specified;
 
     /* flex needs a yyrestart before every file but the first */
 #ifdef FLEX_SCANNER
-    if (restart)	yyrestart(yyin);
+    if (restart && input_map == NULL)	yyrestart(yyin);
     restart = TRUE;
 #endif
 
+    started = trace_time();
+    stats_enter(PHASE_PARSE);
+    begin_alloc_category(ALLOC_DECLARATORS);
     yyparse();
+    end_alloc_category();
+    stats_leave();
+
+    /* if it gave up inside a file the scanner included, close that, without
+     * keeping a snapshot of what it got through.
+     */
+    abandon_snapshots();
+    while (inc_depth > 0)
+	yywrap();
+    end_mapped_file();
+
+    trace_span("parse_file", "parse", "file", name, started, 0);
 
     destroy_symbol_table(enum_table);
     destroy_symbol_table(typedef_names);
@@ -49,13 +49,14 @@ void html_comment()
   put_string("<!");
 }
 
-void html_header(firstpage, input_files, grouped, name, terse, section)
+void html_header(firstpage, input_files, grouped, name, terse, section, date)
    ManualPage         *firstpage;
    int                 input_files;
    boolean             grouped;
    const char         *name;
    const char         *terse;
    const char         *section;
+   Time_t              date;
 {
 
   output_warning();
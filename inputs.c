@@ -0,0 +1,351 @@
+/* $Id$
+ *
+ * Gather the names of the input files, from the command line, from files
+ * listing them, and from directories, so one run can cover a whole tree
+ * without the command line getting too long for the system.
+ */
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "c2man.h"
+#ifdef I_DIRENT
+#include <dirent.h>
+#endif
+#include "strconcat.h"
+#include "strappend.h"
+#include "inputs.h"
+
+/* a list of malloc'ed strings */
+typedef struct NameList
+{
+    char **names;
+    int num, max;
+} NameList;
+
+static NameList inputs, includes, excludes;
+
+/* files taken from directories when no pattern is given */
+static const char *default_includes[] = { "*.c", "*.h", NULL };
+
+static void add_to_list(list, name)
+NameList *list;
+char *name;
+{
+    if (list->num == list->max)
+    {
+	list->max = list->max ? list->max * 2 : 16;
+	if (list->names == NULL)
+	    list->names = (char **)safe_malloc(list->max * sizeof *list->names);
+	else if ((list->names = (char **)realloc(list->names,
+				list->max * sizeof *list->names)) == NULL)
+	    outmem();
+    }
+    list->names[list->num++] = name;
+}
+
+static void free_list(list)
+NameList *list;
+{
+    int i;
+
+    for (i = 0; i < list->num; i++)
+	free(list->names[i]);
+    safe_free(list->names);
+    list->num = list->max = 0;
+}
+
+/* does a name match a shell wildcard pattern, with *, ? and [...]? */
+static boolean match_pattern(pattern, name)
+const char *pattern, *name;
+{
+    for (; *pattern; pattern++, name++)
+    {
+	switch (*pattern)
+	{
+	case '*':
+	    while (pattern[1] == '*')
+		pattern++;
+	    if (pattern[1] == '\0')
+		return TRUE;
+	    for (; *name; name++)
+		if (match_pattern(pattern + 1, name))
+		    return TRUE;
+	    return FALSE;
+
+	case '?':
+	    if (*name == '\0')
+		return FALSE;
+	    break;
+
+	case '[':
+	    {
+		const unsigned char *p = (const unsigned char *)pattern + 1;
+		unsigned char c = *name;
+		boolean negate, found = FALSE;
+
+		if (c == '\0')
+		    return FALSE;
+		if ((negate = *p == '!'))
+		    p++;
+
+		/* a ] straight after the [ stands for itself */
+		do
+		{
+		    if (*p == '\0')
+			return FALSE;
+		    if (p[1] == '-' && p[2] != '\0' && p[2] != ']')
+		    {
+			if (c >= p[0] && c <= p[2])
+			    found = TRUE;
+			p += 3;
+		    }
+		    else if (*p++ == c)
+			found = TRUE;
+		}
+		while (*p != ']');
+
+		if (found == negate)
+		    return FALSE;
+		pattern = (const char *)p;
+	    }
+	    break;
+
+	case '\\':
+	    if (pattern[1] != '\0')
+		pattern++;
+	    /* fall through */
+	default:
+	    if (*pattern != *name)
+		return FALSE;
+	    break;
+	}
+    }
+    return *name == '\0';
+}
+
+/* does a file found in a directory match any of a list of patterns?  Those
+ * with a / in are matched against its whole name, the rest against the part
+ * after the last /.
+ */
+static boolean match_any(patterns, num, path)
+char **patterns;
+int num;
+const char *path;
+{
+    const char *base = strrchr(path, '/');
+    int i;
+
+    base = base ? base + 1 : path;
+    for (i = 0; i < num; i++)
+	if (match_pattern(patterns[i],
+			  strchr(patterns[i], '/') ? path : base))
+	    return TRUE;
+    return FALSE;
+}
+
+void include_input_pattern(pattern)
+const char *pattern;
+{
+    add_to_list(&includes, strduplicate(pattern));
+}
+
+void exclude_input_pattern(pattern)
+const char *pattern;
+{
+    add_to_list(&excludes, strduplicate(pattern));
+}
+
+static boolean add_directory _((const char *dir));
+
+/* add a file or directory found in a directory */
+static boolean add_found(path)
+char *path;
+{
+    struct stat statbuf;
+    int num_includes;
+
+    if (match_any(excludes.names, excludes.num, path))
+    {
+	free(path);
+	return TRUE;
+    }
+
+    /* a dangling link or the like needn't stop the rest being done */
+    if (stat(path, &statbuf) != 0)
+    {
+	my_perror("warning: can't stat", path);
+	free(path);
+	return TRUE;
+    }
+
+    if ((statbuf.st_mode & S_IFMT) == S_IFDIR)
+    {
+	boolean ok = TRUE;
+
+#ifdef HAS_SYMLINK
+	/* don't follow links to directories, which might take us round in
+	 * circles.
+	 */
+	if (lstat(path, &statbuf) == 0 && (statbuf.st_mode & S_IFMT) == S_IFLNK)
+	    fprintf(stderr, "%s: skipping link to directory %s\n",
+							    progname, path);
+	else
+#endif
+	    ok = add_directory(path);
+	free(path);
+	return ok;
+    }
+
+    for (num_includes = 0; default_includes[num_includes]; num_includes++)
+	;
+
+    if (includes.num ? match_any(includes.names, includes.num, path)
+	: match_any((char **)default_includes, num_includes, path))
+	add_to_list(&inputs, path);
+    else
+	free(path);
+    return TRUE;
+}
+
+#ifdef I_DIRENT
+static int compare_names(a, b)
+const void *a, *b;
+{
+    return strcmp(*(char **)a, *(char **)b);
+}
+#endif
+
+/* add everything under a directory, in order of name, so the pages come out
+ * the same however the directory happens to be laid out.
+ */
+static boolean add_directory(dir)
+const char *dir;
+{
+#ifdef I_DIRENT
+    NameList entries;
+    DIR *d;
+    struct dirent *ent;
+    const char *sep = *dir && dir[strlen(dir) - 1] == '/' ? "" : "/";
+    boolean ok = TRUE;
+    int i;
+
+    if ((d = opendir(dir)) == NULL)
+    {
+	my_perror("can't read directory", dir);
+	return FALSE;
+    }
+
+    memset((char *)&entries, 0, sizeof entries);
+    while ((ent = readdir(d)) != NULL)
+	if (strcmp(ent->d_name, ".") != 0 && strcmp(ent->d_name, "..") != 0)
+	    add_to_list(&entries, strconcat(dir, sep, ent->d_name, NULLCP));
+    closedir(d);
+
+    if (entries.num > 1)
+	qsort((char *)entries.names, entries.num, sizeof *entries.names,
+								compare_names);
+
+    /* add_found takes the names over */
+    for (i = 0; i < entries.num; i++)
+	if (!add_found(entries.names[i]))
+	    ok = FALSE;
+    entries.num = 0;
+    free_list(&entries);
+    return ok;
+#else
+    fprintf(stderr, "%s: can't read directory %s on this system\n",
+							    progname, dir);
+    return FALSE;
+#endif
+}
+
+/* add a single name, looking through it if it's a directory and we're
+ * recursing.
+ */
+static boolean add_named(name)
+const char *name;
+{
+    struct stat statbuf;
+
+    if (recurse_dirs && stat(name, &statbuf) == 0 &&
+	(statbuf.st_mode & S_IFMT) == S_IFDIR)
+	return add_directory(name);
+
+    add_to_list(&inputs, strduplicate(name));
+    return TRUE;
+}
+
+/* add the names listed in a file, one to a line; blank lines are ignored */
+static boolean add_list(listname)
+const char *listname;
+{
+    boolean from_stdin = strcmp(listname, "-") == 0;
+    char buf[BUFSIZ], *line = NULL;
+    boolean ok = TRUE;
+    size_t len;
+    FILE *f;
+
+    if (from_stdin)
+	f = stdin;
+    else if ((f = fopen(listname, "r")) == NULL)
+    {
+	my_perror("can't open file list", listname);
+	return FALSE;
+    }
+
+    for (;;)
+    {
+	boolean at_eof = fgets(buf, sizeof buf, f) == NULL;
+
+	if (!at_eof)
+	    line = line ? strappend(line, buf, NULLCP) : strduplicate(buf);
+
+	if (line == NULL)
+	    break;
+
+	/* wait for the rest of a line longer than the buffer */
+	len = strlen(line);
+	if (!at_eof && line[len - 1] != '\n')
+	    continue;
+
+	while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+	    line[--len] = '\0';
+
+	if (len > 0 && !add_named(line))
+	    ok = FALSE;
+	free(line);
+	line = NULL;
+
+	if (at_eof)
+	    break;
+    }
+
+    if (ferror(f))
+    {
+	my_perror("error reading file list", listname);
+	ok = FALSE;
+    }
+    if (!from_stdin)
+	fclose(f);
+    return ok;
+}
+
+boolean add_input_name(name)
+const char *name;
+{
+    return name[0] == '@' ? add_list(name + 1) : add_named(name);
+}
+
+char **input_names(num)
+int *num;
+{
+    *num = inputs.num;
+    return inputs.names;
+}
+
+void free_input_names()
+{
+    free_list(&inputs);
+    free_list(&includes);
+    free_list(&excludes);
+}
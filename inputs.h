@@ -0,0 +1,31 @@
+/* $Id$
+ * gather the names of the input files, from lists and directories
+ */
+#ifndef INPUTS_H
+#define INPUTS_H
+
+#include "c2man.h"
+
+/* only take files matching a pattern when looking through directories */
+void include_input_pattern _((const char *pattern));
+
+/* leave out files and directories matching a pattern when looking through
+ * directories.
+ */
+void exclude_input_pattern _((const char *pattern));
+
+/* add a name from the command line to the input files.  A name starting with
+ * @ gives a file listing them, one to a line, with @- for the standard input;
+ * a directory, if recursing into them, gives every file under it matching the
+ * patterns.
+ * Returns FALSE in the event of failure.
+ */
+boolean add_input_name _((const char *name));
+
+/* the input files gathered so far */
+char **input_names _((int *num));
+
+/* forget the input files and patterns */
+void free_input_names _((void));
+
+#endif
@@ -51,13 +51,14 @@ const char *text;
 
 void latex_comment() { put_string("% "); }
 
-void latex_header(firstpage, input_files, grouped, name, terse, section)
+void latex_header(firstpage, input_files, grouped, name, terse, section, date)
 ManualPage *firstpage;
 int input_files;
 boolean grouped;
 const char *name;
 const char *terse;
 const char *section;
+Time_t date;
 {
     if (make_embeddable) return;
 
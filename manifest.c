@@ -0,0 +1,793 @@
+/* $Id$
+ *
+ * Keep a manifest in the output directory of what each input file made, so a
+ * later run can skip the inputs that haven't changed.
+ *
+ * For each input, the manifest gives a hash of its contents, the files the
+ * preprocessor read for it, the names of the pages made from it and the
+ * output files they went in, and the pages themselves as written by
+ * write_manual_pages.  Every page names all the others under SEE ALSO, so the
+ * pages of the inputs skipped are read back from there; if the names of the
+ * pages come out different from last time, every page is written again.
+ *
+ * The same record of what each input read and made is used to write make
+ * rules, for a build to tell when to run us again.
+ */
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "c2man.h"
+#include "manpage.h"
+#include "serial.h"
+#include "symbol.h"
+#include "depend.h"
+#include "cache.h"
+#include "strconcat.h"
+#include "watch.h"
+#include "manifest.h"
+
+#define MANIFEST_NAME	".c2man-manifest"
+#define MANIFEST_MAGIC	"c2man manifest 1\n"
+
+/* The hash table length should be a prime number. */
+#define ENTRY_HASH	251
+
+/* a list of malloc'ed strings */
+typedef struct StringList
+{
+    char **strings;
+    int num, max;
+} StringList;
+
+/* what the manifest says about an input file */
+typedef struct Entry
+{
+    char *name;			/* the input file */
+    char *hash;			/* hash of its contents */
+    StringList deps;		/* files read while preprocessing it */
+    FileStamp *stamps;		/* and their stamps when they were read */
+    StringList pages;		/* names of the pages made from it */
+    StringList files;		/* output files made from it */
+    FILE *pages_file;		/* where the pages themselves are */
+    long pages_start;		/* their offset in there */
+    long pages_len;		/* and length */
+    boolean changed;		/* has it changed since? */
+    struct Entry *old;		/* the old entry for an input skipped */
+    ManualPage *first_page;	/* the pages made from it, in the list */
+    ManualPage **last_page;
+    int num_pages;
+    struct Entry *next;		/* next entry in the hash bucket */
+} Entry;
+
+/* are we keeping track of the inputs, for a manifest or make rules? */
+static boolean active = FALSE;
+
+static char *manifest_name;
+
+/* what the options and input files come to for this run */
+static char *run_fingerprint;
+
+/* the old manifest, kept open to read the pages from */
+static FILE *old_manifest = NULL;
+
+/* the entries from the old manifest, and those for this run's input files,
+ * in order.
+ */
+static Entry *old_entries = NULL, *new_entries = NULL;
+static int num_old = 0, num_new = 0;
+static Entry *old_table[ENTRY_HASH], *new_table[ENTRY_HASH];
+
+/* the pages processed this time, to go in the new manifest */
+static FILE *page_spool = NULL;
+
+static void add_string(list, s)
+StringList *list;
+const char *s;
+{
+    if (list->num == list->max)
+    {
+	list->max = list->max ? list->max * 2 : 8;
+	if (list->strings == NULL)
+	    list->strings =
+		(char **)safe_malloc(list->max * sizeof *list->strings);
+	else if ((list->strings = (char **)realloc(list->strings,
+				list->max * sizeof *list->strings)) == NULL)
+	    outmem();
+    }
+    list->strings[list->num++] = strduplicate(s);
+}
+
+static void free_strings(list)
+StringList *list;
+{
+    int i;
+
+    for (i = 0; i < list->num; i++)
+	free(list->strings[i]);
+    safe_free(list->strings);
+    list->num = list->max = 0;
+}
+
+static void write_strings(f, list)
+FILE *f;
+StringList *list;
+{
+    int i;
+
+    write_int(f, list->num);
+    for (i = 0; i < list->num; i++)
+	write_string(f, list->strings[i]);
+}
+
+static boolean read_strings(f, list)
+FILE *f;
+StringList *list;
+{
+    char *s;
+    int num, i;
+
+    if (!read_int(f, &num))
+	return FALSE;
+
+    for (i = 0; i < num; i++)
+    {
+	if (!read_string(f, &s) || s == NULL)
+	    return FALSE;
+	add_string(list, s);
+	free(s);
+    }
+    return TRUE;
+}
+
+/* This is a simple hash function mapping a file name to a hash bucket. */
+static unsigned int hash_name(name)
+const char *name;
+{
+    unsigned int h = 0;
+
+    while (*name != '\0')
+	h = (h << 1) ^ *name++;
+    return h % ENTRY_HASH;
+}
+
+static Entry *find_entry(table, name)
+Entry **table;
+const char *name;
+{
+    Entry *e;
+
+    for (e = table[hash_name(name)]; e; e = e->next)
+	if (strcmp(e->name, name) == 0)
+	    return e;
+    return NULL;
+}
+
+static void init_entry(table, e, name)
+Entry **table;
+Entry *e;
+char *name;
+{
+    unsigned int h = hash_name(name);
+
+    memset((char *)e, 0, sizeof *e);
+    e->name = name;
+    e->last_page = &e->first_page;
+    e->next = table[h];
+    table[h] = e;
+}
+
+static void free_entry(e)
+Entry *e;
+{
+    free(e->name);
+    safe_free(e->hash);
+    free_strings(&e->deps);
+    safe_free(e->stamps);
+    free_strings(&e->pages);
+    free_strings(&e->files);
+}
+
+/* keep the files noted for an entry, with their stamps as they were taken */
+static void keep_dependencies(e)
+Entry *e;
+{
+    int i, num = num_dependencies();
+
+    free_strings(&e->deps);
+    safe_free(e->stamps);
+    e->stamps = (FileStamp *)safe_malloc((num ? num : 1) * sizeof *e->stamps);
+    for (i = 0; i < num; i++)
+    {
+	add_string(&e->deps, dependency(i));
+	e->stamps[i] = *dependency_stamp(i);
+    }
+}
+
+/* read the entries from the old manifest.
+ * returns TRUE if it was written for a run with the same fingerprint.
+ */
+static boolean read_manifest(fingerprint)
+const char *fingerprint;
+{
+    char magic[sizeof MANIFEST_MAGIC], *old_fingerprint = NULL, *name;
+    boolean ok, changed;
+    int num, i;
+
+    if ((old_manifest = fopen(manifest_name, "r")) == NULL)
+	return FALSE;
+
+    ok = fgets(magic, sizeof magic, old_manifest) &&
+	strcmp(magic, MANIFEST_MAGIC) == 0 &&
+	read_string(old_manifest, &old_fingerprint) && old_fingerprint &&
+	read_int(old_manifest, &num) && num >= 0;
+
+    if (ok)
+	old_entries = (Entry *)safe_malloc((num ? num : 1) *
+						    sizeof *old_entries);
+
+    for (i = 0; ok && i < num; i++)
+    {
+	Entry *e = &old_entries[i];
+
+	if (!read_string(old_manifest, &name) || name == NULL)
+	{
+	    ok = FALSE;
+	    break;
+	}
+	init_entry(old_table, e, name);
+	num_old++;
+
+	ok = read_string(old_manifest, &e->hash) && e->hash &&
+	    read_dependencies(old_manifest, &changed) &&
+	    read_strings(old_manifest, &e->pages) &&
+	    read_strings(old_manifest, &e->files) &&
+	    fscanf(old_manifest, "%ld", &e->pages_len) == 1 &&
+	    getc(old_manifest) == '\n';
+
+	if (ok)
+	{
+	    keep_dependencies(e);
+	    e->changed = changed;
+	    e->pages_file = old_manifest;
+	    e->pages_start = ftell(old_manifest);
+	    ok = fseek(old_manifest, e->pages_len, 1) == 0;
+	}
+    }
+    clear_dependencies();
+
+    if (!ok)
+    {
+	fprintf(stderr, "%s: ignoring corrupt manifest %s\n", progname,
+								manifest_name);
+	for (i = 0; i < num_old; i++)
+	    free_entry(&old_entries[i]);
+	safe_free(old_entries);
+	num_old = 0;
+	memset((char *)old_table, 0, sizeof old_table);
+	fclose(old_manifest);
+	old_manifest = NULL;
+    }
+
+    ok = ok && strcmp(old_fingerprint, fingerprint) == 0;
+    safe_free(old_fingerprint);
+    return ok;
+}
+
+/* are all the output files made from an input still there? */
+static boolean files_exist(e)
+Entry *e;
+{
+    struct stat statbuf;
+    int i;
+
+    for (i = 0; i < e->files.num; i++)
+	if (stat(e->files.strings[i], &statbuf) != 0)
+	    return FALSE;
+    return TRUE;
+}
+
+void open_manifest(fingerprint, names, num)
+const char *fingerprint;
+char **names;
+int num;
+{
+    boolean same_run, any_changed = FALSE;
+    int i;
+
+    active = TRUE;
+    run_fingerprint = strduplicate(fingerprint);
+    manifest_name = output_dir ? strconcat(output_dir, "/", MANIFEST_NAME,
+					    NULLCP) : strduplicate(MANIFEST_NAME);
+
+    same_run = use_manifest && read_manifest(fingerprint);
+
+    new_entries = (Entry *)safe_malloc((num ? num : 1) * sizeof *new_entries);
+    for (num_new = 0; num_new < num; num_new++)
+    {
+	Entry *e = &new_entries[num_new], *old;
+
+	init_entry(new_table, e, strduplicate(names[num_new]));
+	e->hash = hash_file(e->name, "");
+	e->changed = TRUE;
+
+	if (same_run && e->hash && (old = find_entry(old_table, e->name)) &&
+	    !old->changed && strcmp(old->hash, e->hash) == 0 &&
+	    files_exist(old))
+	{
+	    e->changed = FALSE;
+	    e->old = old;
+	}
+	else
+	    any_changed = TRUE;
+    }
+
+    /* when the pages are all grouped together, or named after the first
+     * input file, they must all be done again if any are.
+     */
+    if (any_changed && (group_together || use_input_name))
+	for (i = 0; i < num_new; i++)
+	{
+	    new_entries[i].changed = TRUE;
+	    new_entries[i].old = NULL;
+	}
+}
+
+boolean manifest_input_changed(name)
+const char *name;
+{
+    Entry *e;
+
+    return !active || (e = find_entry(new_table, name)) == NULL || e->changed;
+}
+
+void manifest_input_done(name)
+const char *name;
+{
+    Entry *e;
+
+    if (!active || (e = find_entry(new_table, name)) == NULL)
+	return;
+
+    keep_dependencies(e);
+}
+
+/* the last of the pages made from an input */
+static ManualPage *last_page(e)
+Entry *e;
+{
+    ManualPage *page = e->first_page;
+    int i;
+
+    for (i = 1; i < e->num_pages; i++)
+	page = page->next;
+    return page;
+}
+
+/* write the pages made from an input processed this time to the spool */
+static boolean spool_pages(e)
+Entry *e;
+{
+    ManualPage *page, *last = NULL, *rest = NULL;
+    int i;
+
+    e->pages_file = page_spool;
+    e->pages_start = ftell(page_spool);
+
+    for (i = 0, page = e->first_page; i < e->num_pages; i++, page = page->next)
+	add_string(&e->pages, page->declarator->name);
+
+    /* write_manual_pages writes to the end of the list */
+    if (e->num_pages)
+    {
+	last = last_page(e);
+	rest = last->next;
+	last->next = NULL;
+    }
+
+    write_manual_pages(page_spool, e->num_pages ? e->first_page : NULL,
+								    NULLCP);
+    if (last)	last->next = rest;
+
+    e->pages_len = ftell(page_spool) - e->pages_start;
+    return !ferror(page_spool);
+}
+
+/* have the names of the pages made from an input changed since last time? */
+static boolean names_changed(e)
+Entry *e;
+{
+    Entry *old;
+    ManualPage *page;
+    int i;
+
+    if ((old = find_entry(old_table, e->name)) == NULL ||
+	old->pages.num != e->num_pages)
+	return TRUE;
+
+    for (i = 0, page = e->first_page; i < e->num_pages; i++, page = page->next)
+	if (strcmp(page->declarator->name, old->pages.strings[i]) != 0)
+	    return TRUE;
+    return FALSE;
+}
+
+boolean manifest_restore_pages()
+{
+    ManualPage **mark, *page, *next, *rest = NULL, **last_rest = &rest;
+    boolean restored = FALSE, rewrite = FALSE;
+    char *terse;
+    Entry *e;
+    int i;
+
+    if (!active || !use_manifest)
+	return TRUE;
+
+    for (i = 0; i < num_new; i++)
+    {
+	e = &new_entries[i];
+	if (e->changed)
+	    continue;
+
+	mark = manual_page_mark();
+	if (fseek(e->old->pages_file, e->old->pages_start, 0) != 0 ||
+	    !read_manual_pages(e->old->pages_file, &terse))
+	{
+	    fprintf(stderr, "%s: bad manual page list in manifest for %s\n",
+							    progname, e->name);
+	    return FALSE;
+	}
+	safe_free(terse);
+
+	for (page = *mark; page; page = page->next)
+	    page->skip_output = TRUE;
+	restored = TRUE;
+    }
+
+    /* sort the pages out by input file, then put them back in that order */
+    for (page = firstpage; page; page = next)
+    {
+	next = page->next;
+	page->next = NULL;
+
+	if (page->sourcefile && (e = find_entry(new_table, page->sourcefile)))
+	{
+	    *e->last_page = page;
+	    e->last_page = &page->next;
+	    e->num_pages++;
+	}
+	else
+	{
+	    *last_rest = page;
+	    last_rest = &page->next;
+	}
+    }
+    forget_manual_pages();
+
+    for (i = 0; i < num_new; i++)
+    {
+	e = &new_entries[i];
+	for (page = e->first_page; page; page = next)
+	{
+	    next = page->next;
+	    add_manual_page(page);
+	}
+	if (e->changed && restored && names_changed(e))
+	    rewrite = TRUE;
+    }
+    for (page = rest; page; page = next)
+    {
+	next = page->next;
+	add_manual_page(page);
+    }
+
+    /* SEE ALSO names every other page, so they must all be written again */
+    if (rewrite)
+	for (page = firstpage; page; page = page->next)
+	    page->skip_output = FALSE;
+
+    /* keep a copy of the pages processed this time, before they're output */
+    if ((page_spool = tmpfile()) == NULL)
+    {
+	my_perror("can't create temporary file for", manifest_name);
+	return FALSE;
+    }
+    for (i = 0; i < num_new; i++)
+	if (new_entries[i].changed && !spool_pages(&new_entries[i]))
+	{
+	    my_perror("error writing temporary file for", manifest_name);
+	    return FALSE;
+	}
+
+    return TRUE;
+}
+
+void manifest_add_file(name, file)
+const char *name;
+const char *file;
+{
+    Entry *e;
+
+    if (active && name && (e = find_entry(new_table, name)) && e->changed)
+	add_string(&e->files, file);
+}
+
+/* copy the pages for an entry into the new manifest */
+static boolean copy_pages(f, e)
+FILE *f;
+Entry *e;
+{
+    char buf[BUFSIZ];
+    long left = e->pages_len;
+    size_t n;
+
+    fprintf(f, "%ld\n", e->pages_len);
+    if (left && fseek(e->pages_file, e->pages_start, 0) != 0)
+	return FALSE;
+
+    while (left > 0)
+    {
+	n = fread(buf, 1, left < (long)sizeof buf ? (size_t)left : sizeof buf,
+							    e->pages_file);
+	if (n == 0 || fwrite(buf, 1, n, f) != n)
+	    return FALSE;
+	left -= n;
+    }
+    return TRUE;
+}
+
+/* write the new manifest */
+static boolean write_manifest()
+{
+    char buf[20], *temp_name;
+    FILE *f;
+    boolean ok = TRUE;
+    int i, j;
+
+    /* write it under a name of our own, then rename it into place */
+    sprintf(buf, ".%ld", (long)getpid());
+    temp_name = strconcat(manifest_name, buf, NULLCP);
+
+    if ((f = fopen(temp_name, "w")) == NULL)
+    {
+	my_perror("can't write manifest", temp_name);
+	free(temp_name);
+	return FALSE;
+    }
+
+    fputs(MANIFEST_MAGIC, f);
+    write_string(f, run_fingerprint);
+    write_int(f, num_new);
+
+    for (i = 0; ok && i < num_new; i++)
+    {
+	Entry *e = &new_entries[i], *from = e->changed ? e : e->old;
+
+	write_string(f, e->name);
+	write_string(f, e->hash ? e->hash : "");
+
+	/* with the stamps taken as they were read, not as they are now */
+	clear_dependencies();
+	for (j = 0; j < from->deps.num; j++)
+	    add_stamped_dependency(from->deps.strings[j], &from->stamps[j]);
+	write_dependencies(f);
+
+	write_strings(f, &from->pages);
+	write_strings(f, &from->files);
+	ok = copy_pages(f, from);
+    }
+    clear_dependencies();
+
+    if (fclose(f) == EOF)	ok = FALSE;
+
+    if (!ok || rename(temp_name, manifest_name) != 0)
+    {
+	my_perror("error writing manifest", temp_name);
+	unlink(temp_name);
+	ok = FALSE;
+    }
+
+    free(temp_name);
+    return ok;
+}
+
+/* remove the output files made last time that weren't made this time */
+static boolean remove_old_files()
+{
+    SymbolTable *made = create_symbol_table();
+    boolean ok = TRUE;
+    int i, j;
+
+    for (i = 0; i < num_new; i++)
+    {
+	Entry *from = new_entries[i].changed ? &new_entries[i]
+					     : new_entries[i].old;
+	for (j = 0; j < from->files.num; j++)
+	    new_symbol(made, from->files.strings[j], 0);
+    }
+
+    for (i = 0; i < num_old; i++)
+	for (j = 0; j < old_entries[i].files.num; j++)
+	{
+	    char *file = old_entries[i].files.strings[j];
+
+	    if (find_symbol(made, file) == NULL)
+	    {
+		fprintf(stderr, "removing: %s\n", file);
+		if (!remove_old_file(file))
+		    ok = FALSE;
+		new_symbol(made, file, 0);	/* only try once */
+	    }
+	}
+
+    destroy_symbol_table(made);
+    return ok;
+}
+
+/* write a name in a make rule, escaping anything make would take apart */
+static void put_make_name(f, name)
+FILE *f;
+const char *name;
+{
+    for (; *name; name++)
+    {
+	if (*name == '$')
+	    putc('$', f);
+	else if (*name == ' ' || *name == '\t' || *name == '#')
+	    putc('\\', f);
+	putc(*name, f);
+    }
+}
+
+/* the name of the file to write the make rule for an input in: its path
+ * under the output directory, with .d added, so inputs of the same name in
+ * different directories don't share one.  A leading / is dropped, and each
+ * .. becomes __, to keep it under the output directory.
+ */
+static char *rule_file_name(name)
+const char *name;
+{
+    char *rule_name, *p, *q;
+
+    while (*name == '/' || (name[0] == '.' && name[1] == '/'))
+	name += *name == '/' ? 1 : 2;
+
+    rule_name = output_dir ? strconcat(output_dir, "/", name, ".d", NULLCP)
+			   : strconcat(name, ".d", NULLCP);
+
+    /* q is the start of each directory in turn, and p the / after it */
+    for (q = output_dir ? rule_name + strlen(output_dir) + 1 : rule_name;
+					(p = strchr(q, '/')) != NULL; q = p + 1)
+	if (p == q + 2 && q[0] == '.' && q[1] == '.')
+	    q[0] = q[1] = '_';
+    return rule_name;
+}
+
+/* make the directories a file is to go in that aren't there already, from
+ * the first after skip characters of its name.
+ */
+static void make_dirs_for(name, skip)
+char *name;
+size_t skip;
+{
+    char *slash;
+
+    for (slash = strchr(name + skip, '/'); slash;
+					    slash = strchr(slash + 1, '/'))
+    {
+	*slash = '\0';
+	if (mkdir(name, 0777) == -1 && errno != EEXIST)
+	    my_perror("can't create directory", name);
+	*slash = '/';
+    }
+}
+
+/* write a make rule for an input, with the output files made from it
+ * depending on the files read while preprocessing it, and an empty rule for
+ * each of those but the input itself, so make carries on if it goes.
+ * If no output files were made from it, any rule left from before is removed.
+ */
+static boolean write_make_rule(e)
+Entry *e;
+{
+    char *rule_name = rule_file_name(e->name);
+    FILE *f;
+    boolean ok;
+    int i;
+
+    if (e->files.num == 0)
+    {
+	ok = remove_old_file(rule_name);
+	free(rule_name);
+	return ok;
+    }
+
+    fprintf(stderr,"generating: %s\n",rule_name);
+    if (!remove_old_file(rule_name))
+    {
+	free(rule_name);
+	return FALSE;
+    }
+    make_dirs_for(rule_name, output_dir ? strlen(output_dir) + 1 : 0);
+    if ((f = fopen(rule_name, "w")) == NULL)
+    {
+	my_perror("error opening output file", rule_name);
+	free(rule_name);
+	return FALSE;
+    }
+
+    for (i = 0; i < e->files.num; i++)
+    {
+	if (i > 0)	fputs(" \\\n ", f);
+	put_make_name(f, e->files.strings[i]);
+    }
+    putc(':', f);
+    for (i = 0; i < e->deps.num; i++)
+    {
+	fputs(" \\\n ", f);
+	put_make_name(f, e->deps.strings[i]);
+    }
+    putc('\n', f);
+
+    for (i = 0; i < e->deps.num; i++)
+	if (strcmp(e->deps.strings[i], e->name) != 0)
+	{
+	    putc('\n', f);
+	    put_make_name(f, e->deps.strings[i]);
+	    fputs(":\n", f);
+	}
+
+    ok = !ferror(f);
+    if (fclose(f) == EOF)	ok = FALSE;
+    if (!ok)
+	my_perror("error writing output file", rule_name);
+
+    free(rule_name);
+    return ok;
+}
+
+boolean close_manifest(ok)
+boolean ok;
+{
+    boolean any_changed = num_old != num_new;
+    int i;
+
+    if (!active)
+	return ok;
+
+    for (i = 0; i < num_new; i++)
+	if (new_entries[i].changed)
+	    any_changed = TRUE;
+
+    if (ok && use_manifest && any_changed)
+	ok = write_manifest() && remove_old_files();
+
+    /* tell the watcher what to watch for the next run */
+    for (i = 0; i < num_new; i++)
+    {
+	Entry *from = new_entries[i].changed ? &new_entries[i]
+					     : new_entries[i].old;
+	int j;
+
+	watch_file(new_entries[i].name);
+	for (j = 0; j < from->deps.num; j++)
+	    watch_file(from->deps.strings[j]);
+    }
+
+    /* those skipped still have the rules written last time */
+    for (i = 0; ok && write_make_rules && i < num_new; i++)
+	if (new_entries[i].changed)
+	    ok = write_make_rule(&new_entries[i]);
+
+    for (i = 0; i < num_new; i++)
+	free_entry(&new_entries[i]);
+    for (i = 0; i < num_old; i++)
+	free_entry(&old_entries[i]);
+    safe_free(new_entries);
+    safe_free(old_entries);
+    if (old_manifest)	fclose(old_manifest);
+    if (page_spool)	fclose(page_spool);
+    free(manifest_name);
+    free(run_fingerprint);
+    active = FALSE;
+
+    return ok;
+}
@@ -0,0 +1,43 @@
+/* $Id$
+ * keep track of what each input file made, to skip those that haven't changed
+ */
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include "c2man.h"
+
+/* start using the manifest in the output directory, for a run over the input
+ * files given, with options summed up by fingerprint.  Without one, this
+ * just keeps track of what the inputs read and made, for the make rules.
+ */
+void open_manifest _((const char *fingerprint, char **names, int num));
+
+/* does an input file have to be processed again?  It does if its contents,
+ * or any file the preprocessor read for it, changed since the manifest was
+ * written, or any output file made from it has gone; or if the options or
+ * list of input files are different.
+ */
+boolean manifest_input_changed _((const char *name));
+
+/* note the files read while preprocessing an input, as kept by depend.c */
+void manifest_input_done _((const char *name));
+
+/* add the pages from the inputs that are being skipped back into the list,
+ * so those processed again name them under SEE ALSO, and put the list in the
+ * order of the input files.  The pages read back aren't written again unless
+ * the names of the pages have changed.
+ * Returns FALSE in the event of failure.
+ */
+boolean manifest_restore_pages _((void));
+
+/* note an output file made from an input, as the pages are written */
+void manifest_add_file _((const char *name, const char *file));
+
+/* finish with the manifest; if ok, write the new one and remove any output
+ * file that nothing was made in this time, and write the make rules for the
+ * inputs processed.
+ * Returns FALSE in the event of failure.
+ */
+boolean close_manifest _((boolean ok));
+
+#endif
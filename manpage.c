@@ -18,10 +18,14 @@
 #include "strappend.h"
 #include "semantic.h"
 #include "output.h"
+#include "manifest.h"
+#include "stats.h"
+#include "trace.h"
 
 #ifdef I_SYS_FILE
 #include <sys/file.h>
 #endif
+#include <sys/stat.h>
 
 /* list of manual pages */
 ManualPage *firstpage = NULL;
@@ -37,8 +41,10 @@ new_manual_page(comment, decl_spec, declarator)
 {
     ManualPage *newpage;
 
-    /* check that we really want a man page for this */
-    if ((!comment) ||
+    /* check that we really want a man page for this; when checking
+     * coverage, we keep the undocumented ones too, to report them.
+     */
+    if ((!comment && !check_coverage) ||
 	!inbasefile ||
 	(!variables_out && !is_function_declarator(declarator)) ||
 	(decl_spec->flags & DS_JUNK) ||
@@ -58,17 +64,60 @@ new_manual_page(comment, decl_spec, declarator)
     
     declarator->comment = comment;
     
+    begin_alloc_category(ALLOC_PAGES);
     newpage = (ManualPage *)safe_malloc(sizeof *newpage);
     newpage->decl_spec = (DeclSpec *)safe_malloc(sizeof *newpage->decl_spec);
     newpage->declarator = declarator;
 
     *newpage->decl_spec = *decl_spec;
     newpage->sourcefile = strduplicate(basefile);
+    end_alloc_category();
     newpage->sourcetime = basetime;
+    newpage->skip_output = FALSE;
+
+    add_manual_page(newpage);
+}
+
+/* add a page to the end of the list of manual pages */
+void add_manual_page(page)
+     ManualPage *page;
+{
+    *lastpagenext = page;
+    page->next = NULL;
+    lastpagenext = &page->next;
+}
 
-    *lastpagenext = newpage;
-    newpage->next = NULL;
-    lastpagenext = &newpage->next;
+/* start a new, empty list of manual pages without freeing the old one; a
+ * worker process uses this since its copy of the list belongs to its parent.
+ */
+void forget_manual_pages()
+{
+    firstpage = NULL;
+    lastpagenext = &firstpage;
+}
+
+/* where the next page will go on the end of the list; any pages added after
+ * it was taken can be thrown away again with truncate_manual_pages.
+ */
+ManualPage **manual_page_mark()
+{
+    return lastpagenext;
+}
+
+/* throw away the pages added to the list since the mark was taken */
+void truncate_manual_pages(mark)
+     ManualPage **mark;
+{
+    ManualPage *page, *next;
+
+    for (page = *mark; page; page = next)
+    {
+	next = page->next;
+	free_manual_page(page);
+	free(page);
+    }
+    *mark = NULL;
+    lastpagenext = mark;
 }
 
 void free_manual_page(page)
@@ -786,8 +835,75 @@ const char *section;
     return 0;
 }
 
+/* the date a page should carry.  If lots of files contributed, use the current
+ * time; otherwise use the time of the source file they came from.  A date
+ * given with -E is used instead, and one from SOURCE_DATE_EPOCH instead of any
+ * later.
+ */
+static Time_t page_date(firstpage, input_files, grouped)
+ManualPage *firstpage;
+int input_files;
+boolean grouped;
+{
+    Time_t date = (grouped && input_files > 1) ? time((Time_t *)NULL)
+					       : firstpage->sourcetime;
+
+    if (date_given && (!clamp_date || date > given_date))
+	date = given_date;
+    return date;
+}
 
-/* Writes the entire contents of the manual page specified by basepage. */
+/* split up the comment for a page into its description, RETURNS and any
+ * other sections, finding the RETURNS wherever it may be.
+ */
+static void split_page_comment(page, terse)
+    ManualPage *page;
+    char **terse;	/* where to put the terse description, if wanted */
+{
+    boolean explicit_description;
+
+    stats_enter(PHASE_SPLIT);
+    explicit_description =
+	split_function_comment(page->declarator->comment,
+	    page->declarator->name, terse,
+	    &page->description,&page->returns,&page->first_section);
+    stats_leave();
+
+    /* we may need to look harder if RETURNS wasn't easy to find in the
+     * function comment.
+     */
+    if (page->returns == NULL)
+    {
+	/* if there was a retcomment supplied by the declarator, use it if
+	 * we couldn't split anything from the function comment.
+	 */
+	if (page->declarator->retcomment)
+	{
+	    /* take a copy, so the page can be written again */
+	    page->returns = strduplicate(page->declarator->retcomment);
+	}
+	else
+	    /* if there wasn't a RETURNS section, and the DESCRIPTION field
+	     * was not explicit, see if we can split one out of the
+	     * description field.
+	     */
+	    if (!explicit_description)
+	    {
+		char *newdesc;
+		if (split_returns_comment(page->description, &newdesc,
+							&page->returns))
+		{
+		    free(page->description);
+		    page->description = newdesc;
+		}
+	    }
+    }
+}
+
+/* Writes the entire contents of the manual page specified by basepage.  The
+ * comments are split up afresh each time, so a page may be written more than
+ * once, in different formats.
+ */
 void
 output_manpage(firstpage, basepage, input_files, title, section)
     /* the first page in the list of all manual pages.  This is used to build
@@ -817,43 +933,7 @@ output_manpage(firstpage, basepage, input_files, title, section)
     /* split up all the function comments for this page */
     for (page = basepage; page; page = page->next)
     {
-	boolean explicit_description =
-	    split_function_comment(page->declarator->comment,
-		page->declarator->name,
-		group_together ? (char **)NULL : &terse,
-		&page->description,&page->returns,&page->first_section);
-
-	/* we may need to look harder if RETURNS wasn't easy to find in the
-	 * function comment.
-	 */
-	if (page->returns == NULL)
-	{
-	    /* if there was a retcomment supplied by the declarator, use it if
-	     * we couldn't split anything from the function comment.
-	     */
-	    if (page->declarator->retcomment)
-	    {
-		page->returns = page->declarator->retcomment;
-
-		/* page->returns now owns the string */
-		page->declarator->retcomment = NULL;
-	    }
-	    else
-		/* if there wasn't a RETURNS section, and the DESCRIPTION field
-		 * was not explicit, see if we can split one out of the
-		 * description field.
-		 */
-		if (!explicit_description)
-		{
-		    char *newdesc;
-		    if (split_returns_comment(page->description, &newdesc,
-							    &page->returns))
-		    {
-			free(page->description);
-			page->description = newdesc;
-		    }
-		}
-	}
+	split_page_comment(page, group_together ? (char **)NULL : &terse);
 
 	if (!group_together)	break;
     }
@@ -862,7 +942,8 @@ output_manpage(firstpage, basepage, input_files, title, section)
     terseout = group_terse ? group_terse : (terse ? terse : "Not Described");
 
     output->header(basepage, input_files, grouped,
-		title ? title : basepage->declarator->name, terseout, section);
+		title ? title : basepage->declarator->name, terseout, section,
+		page_date(basepage, input_files, grouped));
     
     output->name(NULL);
     /* output the names of all the stuff documented on this page */
@@ -1014,8 +1095,8 @@ output_manpage(firstpage, basepage, input_files, title, section)
 
 		output_identifier_description(page->returns, output->returns,
 					    page->decl_spec, page->declarator);
-		safe_free(page->returns);
 	    }
+	    safe_free(page->returns);
 
 	    if (!grouped)	break;
 	}
@@ -1068,6 +1149,7 @@ output_manpage(firstpage, basepage, input_files, title, section)
 	    safe_free(section->text);
 	    free(section);
 	}
+	page->first_section = NULL;
 
 	if (!grouped)	break;
     }
@@ -1195,6 +1277,241 @@ const char *name;
     return TRUE;
 }
 
+/* When only writing files whose contents change, each is written under a new
+ * name next to it, then compared with the old one; it only replaces that,
+ * by renaming it into place, if it's different.  These are the new name and
+ * the file it's for.
+ */
+static char *new_file_name = NULL;
+static char *old_file_name = NULL;
+
+/* make a name for a new file next to an old one */
+static char *new_name_for(name)
+const char *name;
+{
+    char buf[20];
+
+    sprintf(buf, ".%ld", (long)getpid());
+    return strconcat(name, buf, NULLCP);
+}
+
+/* do two files have the same contents? */
+static boolean same_contents(name1, name2)
+const char *name1, *name2;
+{
+    FILE *f1, *f2;
+    char buf1[BUFSIZ], buf2[BUFSIZ];
+    size_t n1, n2;
+    boolean same = FALSE;
+
+    if ((f1 = fopen(name1, "r")) == NULL)
+	return FALSE;
+    if ((f2 = fopen(name2, "r")) != NULL)
+    {
+	do
+	{
+	    n1 = fread(buf1, 1, sizeof buf1, f1);
+	    n2 = fread(buf2, 1, sizeof buf2, f2);
+	    same = n1 == n2 && memcmp(buf1, buf2, n1) == 0;
+	}
+	while (same && n1 > 0);
+
+	if (ferror(f1) || ferror(f2))
+	    same = FALSE;
+	fclose(f2);
+    }
+    fclose(f1);
+    return same;
+}
+
+/* put a new file in place of the old one, unless they're the same.
+ * returns FALSE in the event of failure.
+ */
+static boolean replace_file(new_name, name)
+const char *new_name, *name;
+{
+    struct stat buf;
+
+    if (same_contents(new_name, name))
+    {
+	unlink(new_name);
+	return TRUE;
+    }
+
+    /* keep the old file's mode, rather than whatever the new one got */
+    if (stat(name, &buf) == 0 && chmod(new_name, buf.st_mode & 07777) == -1)
+    {
+	my_perror("can't set mode of output file", new_name);
+	unlink(new_name);
+	return FALSE;
+    }
+
+    if (rename(new_name, name) == -1)
+    {
+	my_perror("error replacing output file", name);
+	unlink(new_name);
+	return FALSE;
+    }
+    return TRUE;
+}
+
+/* finish with the new file being written, if any, replacing the old one if
+ * it's different.
+ * returns FALSE in the event of failure.
+ */
+static boolean finish_new_file()
+{
+    boolean ok;
+
+    if (new_file_name == NULL)
+	return TRUE;
+
+    ok = replace_file(new_file_name, old_file_name);
+    safe_free(new_file_name);
+    safe_free(old_file_name);
+    return ok;
+}
+
+/* send the standard output to an output file, or to a new file to replace it
+ * if need be.
+ * returns FALSE in the event of failure.
+ */
+static boolean open_output_file(name)
+const char *name;
+{
+    const char *open_name = name;
+
+    if (write_if_changed)
+    {
+	/* finish the last, now we're done writing it */
+	if (new_file_name &&
+	    (fflush(stdout) == EOF || !finish_new_file()))
+	{
+	    my_perror("error writing output file", name);
+	    return FALSE;
+	}
+
+#ifdef HAS_ACCESS
+	/* check we could have replaced it the usual way */
+	if (access(name,W_OK) == -1 && errno != ENOENT)
+	{
+	    my_perror("can't access output file", name);
+	    return FALSE;
+	}
+#endif
+	open_name = new_file_name = new_name_for(name);
+	old_file_name = strduplicate(name);
+    }
+    /* a previous run may have left links, so nuke old file first */
+    else if (!remove_old_file(name))
+	return FALSE;
+
+    if (freopen(open_name, "w", stdout) == NULL)
+    {
+	my_perror("error opening output file", open_name);
+	return FALSE;
+    }
+    return TRUE;
+}
+
+/* close the output file, replacing the old one with it if need be.
+ * returns FALSE in the event of failure.
+ */
+static boolean close_output_file(name)
+const char *name;
+{
+    if (fclose(stdout) == EOF)
+    {
+	my_perror("error closing output file", name);
+	return FALSE;
+    }
+    return finish_new_file();
+}
+
+#ifdef HAS_LINK
+/* is a name a hard link to a file?  A symbolic link to it isn't. */
+static boolean same_file(linkname, name)
+const char *linkname, *name;
+{
+    struct stat buf1, buf2;
+
+#ifdef HAS_SYMLINK
+    if (lstat(linkname, &buf1) != 0)
+#else
+    if (stat(linkname, &buf1) != 0)
+#endif
+	return FALSE;
+    return stat(name, &buf2) == 0 &&
+	buf1.st_dev == buf2.st_dev && buf1.st_ino == buf2.st_ino;
+}
+#endif
+
+#ifdef HAS_SYMLINK
+/* is a name a symbolic link to a file? */
+static boolean links_to(linkname, name)
+const char *linkname, *name;
+{
+#ifdef HAS_READLINK
+    char buf[1024];
+    int len = readlink(linkname, buf, sizeof buf - 1);
+
+    if (len < 0)
+	return FALSE;
+    buf[len] = '\0';
+    return strcmp(buf, name) == 0;
+#else
+    return FALSE;
+#endif
+}
+#endif
+
+#if defined(HAS_LINK) || defined(HAS_SYMLINK)
+/* link a file to another name in place of whatever is there, when only
+ * writing files whose contents change.  The link is made under a new name and
+ * renamed into place, unless it's there already.
+ * returns -1 in the event of failure.
+ */
+static int replace_link(filename, linkname, link_type)
+const char *filename, *linkname;
+enum LinkType link_type;
+{
+    char *new_name;
+    int result;
+
+    switch (link_type)
+    {
+#ifdef HAS_LINK
+    case LINK_HARD:
+	if (same_file(linkname, filename))
+	    return 0;
+	new_name = new_name_for(linkname);
+	unlink(new_name);
+	result = link(filename, new_name);
+	break;
+#endif
+#ifdef HAS_SYMLINK
+    case LINK_SOFT:
+	if (links_to(linkname, filename))
+	    return 0;
+	new_name = new_name_for(linkname);
+	unlink(new_name);
+	result = symlink(filename, new_name);
+	break;
+#endif
+    default:
+	return 0;
+    }
+
+    if (result == 0 && rename(new_name, linkname) == -1)
+    {
+	unlink(new_name);
+	result = -1;
+    }
+    free(new_name);
+    return result;
+}
+#endif
+
 /* output all the manual pages in a list */
 void output_manual_pages(first, input_files, link_type)
     ManualPage *first;
@@ -1217,6 +1534,11 @@ void output_manual_pages(first, input_files, link_type)
 	 * the nroff output header.
 	 */
 	const char *section = page_manual_section(output_type);
+	long start;
+	double started;
+
+	stats_file(page->sourcefile ? page->sourcefile : "stdin");
+	stats_enter(PHASE_OUTPUT);
 
 	/* work out the base name of the file this was generated from */
 	if (page->sourcefile)
@@ -1238,29 +1560,43 @@ void output_manual_pages(first, input_files, link_type)
 
 	if (!tostdout)
 	{
+	    /* with a manifest, the file may not need writing again */
+	    if (page->skip_output)
+	    {
+		safe_free(input_file_base);
+		stats_leave();
+		continue;
+	    }
+
 	    safe_free(filename);	/* free previous, if any */
 	    filename = page_file_name(
 		use_input_name && input_file_base
 				? input_file_base : page->declarator->name,
 		output_type, section);
 	    fprintf(stderr,"generating: %s\n",filename);
+	    manifest_add_file(page->sourcefile, filename);
 
-	    /* a previous run may have left links, so nuke old file first */
-	    if (!remove_old_file(filename))	exit(1);
-
-	    if (freopen(filename, "w", stdout) == NULL)
+	    if (!open_output_file(filename))
 	    {
-		my_perror("error opening output file", filename);
 		free(filename);
 		exit(1);
 	    }
 	}
 
-	/* do the page itself */
+	/* do the page itself, counting what's written if we can tell */
+	start = keep_stats ? ftell(stdout) : -1L;
+	started = trace_time();
 	output_manpage(first, page, input_files,
 	    group_together && input_file_base ? input_file_base
 					      : page->declarator->name,
 	    group_together ? manual_section : section);
+	trace_span("output_manpage", "output", "page", page->declarator->name,
+								started, 0);
+
+	if (start != -1L && ftell(stdout) != -1L)
+	    stats_count(COUNT_BYTES_WRITTEN, ftell(stdout) - start);
+	stats_count(COUNT_PAGES, 1L);
+	stats_leave();
 
 	safe_free(input_file_base);
 
@@ -1271,11 +1607,8 @@ void output_manual_pages(first, input_files, link_type)
     }
 
     /* close the last output file if there was one */
-    if (!tostdout && fclose(stdout) == EOF)
-    {
-	my_perror("error linking closing file", filename);
+    if (!tostdout && filename && !close_output_file(filename))
 	exit(1);
-    }
 
     /* if pages are grouped, just link the rest to the first */
     if (group_together && !tostdout && link_type != LINK_NONE)
@@ -1301,31 +1634,39 @@ void output_manual_pages(first, input_files, link_type)
 		link_type == LINK_REMOVE ? "removing" : "linking", linkname);
 
 	    /* always nuke old output file, since it may be linked to the one
-	     * we've just generated, so LINK_FILE may trash it.
+	     * we've just generated, so LINK_FILE may trash it.  If we're only
+	     * writing what changes, the old one is replaced by renaming a new
+	     * one over it, which can't trash anything.
 	     */
-	    if (!remove_old_file(linkname))	exit(1);
+	    if ((!write_if_changed || link_type == LINK_REMOVE) &&
+		!remove_old_file(linkname))
+		exit(1);
 
 	    switch(link_type)
 	    {
 #ifdef HAS_LINK
 	    case LINK_HARD:
-		result = link(filename, linkname);
+		result = write_if_changed ?
+		    replace_link(filename, linkname, link_type) :
+		    link(filename, linkname);
 		break;
 #endif
 #ifdef HAS_SYMLINK
 	    case LINK_SOFT:
-		result = symlink(filename, linkname);
+		result = write_if_changed ?
+		    replace_link(filename, linkname, link_type) :
+		    symlink(filename, linkname);
 		break;
 #endif
 	    case LINK_FILE:
-		if (freopen(linkname, "w", stdout) == NULL)
+		if (!open_output_file(linkname))
 		{
 		    result = -1;
 		    break;
 		}
 		output_warning();
 		output->include(filename);
-		if (fclose(stdout) == EOF)
+		if (!close_output_file(linkname))
 		    result = -1;
 		break;
 	    case LINK_NONE:
@@ -1339,9 +1680,135 @@ void output_manual_pages(first, input_files, link_type)
 		my_perror("error linking output file", linkname);
 		exit(1);
 	    }
+	    if (link_type != LINK_REMOVE)
+		manifest_add_file(page->sourcefile, linkname);
 	    free(linkname);
 	}
     }
 
     safe_free(filename);
 }
+
+/* does a function return nothing, so there's nothing for RETURNS to say? */
+static boolean returns_void(page)
+const ManualPage *page;
+{
+    const char *type = page->decl_spec->text;
+    const Declarator *d = page->declarator;
+    size_t len = strlen(type);
+
+    /* it's void if it's declared void and isn't a pointer to anything */
+    return len >= 4 && strcmp(type + len - 4, "void") == 0 &&
+	(len == 4 || type[len - 5] == ' ') &&
+	strncmp(d->text, d->name, strlen(d->name)) == 0;
+}
+
+/* report what the comments on the manual pages leave undocumented: the
+ * identifiers with no comment at all, the parameters without comments, and
+ * the functions with something to return but no RETURNS section.  An
+ * undocumented function counts its parameters and return value against the
+ * total too, but only its name is reported.
+ * returns FALSE if less than the given percentage of them all is documented.
+ */
+boolean check_manual_pages(first, threshold)
+    ManualPage *first;
+    int threshold;
+{
+    ManualPage *page;
+    int identifiers = 0, params = 0, returns = 0;
+    int missing_identifiers = 0, missing_params = 0, missing_returns = 0;
+    int total, missing;
+    double coverage;
+
+    for (page = first; page; page = page->next)
+    {
+	const char *file = page->sourcefile ? page->sourcefile : "stdin";
+	Declarator *d = page->declarator;
+	boolean documented = d->comment != NULL;
+	boolean function = is_function_declarator(d);
+
+	identifiers++;
+	if (!documented)
+	{
+	    missing_identifiers++;
+	    printf("%s: %s is not documented\n", file, d->name);
+	}
+
+	if (!function)
+	    continue;
+
+	if (has_parameters(d->head))
+	{
+	    Parameter *p;
+	    int n = 0;
+
+	    for (p = d->head->params.first; p; p = p->next)
+	    {
+		n++;
+		params++;
+		if (p->declarator->comment)
+		    continue;
+
+		missing_params++;
+		if (!documented)
+		    continue;
+
+		if (p->declarator->name && p->declarator->name[0])
+		    printf("%s: %s: parameter %s is not documented\n", file,
+						    d->name, p->declarator->name);
+		else
+		    printf("%s: %s: parameter %d is not documented\n", file,
+						    d->name, n);
+	    }
+	}
+
+	if (returns_void(page))
+	    continue;
+
+	returns++;
+	if (!documented)
+	{
+	    missing_returns++;
+	    continue;
+	}
+
+	split_page_comment(page, (char **)NULL);
+	if (!needs_returns_section(page))
+	{
+	    missing_returns++;
+	    printf("%s: %s: no RETURNS section\n", file, d->name);
+	}
+
+	/* the rest of the comment isn't needed */
+	safe_free(page->description);
+	safe_free(page->returns);
+	while (page->first_section)
+	{
+	    Section *next = page->first_section->next;
+
+	    free(page->first_section->name);
+	    safe_free(page->first_section->text);
+	    free(page->first_section);
+	    page->first_section = next;
+	}
+    }
+
+    total = identifiers + params + returns;
+    missing = missing_identifiers + missing_params + missing_returns;
+    coverage = total ? 100.0 * (total - missing) / total : 100.0;
+
+    printf("documented: %d of %d identifiers, %d of %d parameters, "
+	"%d of %d return values\n", identifiers - missing_identifiers,
+	identifiers, params - missing_params, params,
+	returns - missing_returns, returns);
+    printf("coverage: %.1f%%\n", coverage);
+
+    if (coverage < threshold)
+    {
+	fflush(stdout);
+	fprintf(stderr, "%s: coverage of %.1f%% is below the %d%% required\n",
+					    progname, coverage, threshold);
+	return FALSE;
+    }
+    return TRUE;
+}
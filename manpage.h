@@ -26,6 +26,7 @@ struct ManualPage
     char *returns;
     char *sourcefile;
     Time_t sourcetime;
+    boolean skip_output;	/* is its output file already up to date? */
 };
 
 enum LinkType
@@ -55,6 +56,28 @@ void output_manual_pages _((ManualPage *first, int num_input_files,
 
 void free_manual_pages _((ManualPage *first));
 
+/* report what's undocumented on the pages, instead of writing them.
+ * returns FALSE if less than threshold percent of it all is documented.
+ */
+boolean check_manual_pages _((ManualPage *first, int threshold));
+
+void free_manual_page _((ManualPage *page));
+
+/* add a page to the end of the list of manual pages */
+void add_manual_page _((ManualPage *page));
+
+/* start a new list, leaving the old one alone */
+void forget_manual_pages _((void));
+
+/* mark the end of the list, so pages added after it can be thrown away */
+ManualPage **manual_page_mark _((void));
+
+/* throw away the pages added to the list since the mark was taken */
+void truncate_manual_pages _((ManualPage **mark));
+
+/* remove an existing file, if it exists & we have write permission to it */
+int remove_old_file _((const char *name));
+
 void output_format_string _((const char *fmt));
 
 void output_warning _((void));
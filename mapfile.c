@@ -0,0 +1,139 @@
+/* $Id$
+ *
+ * Map input files into memory, for the scanner to read in place rather than
+ * copying them through stdio and then through its own buffer.
+ *
+ * Flex wants two NULs after a buffer it scans in place, and may write into it
+ * as it goes, so we map some zeroed memory a little longer than the file, then
+ * map a private copy of the file over the start of it.  The end of the file's
+ * last page reads as zeroes, and if the file ends too near the end of a page
+ * to hold both, they're in the zeroed page after it.
+ *
+ * Pages of a mapped file are only read when they're first touched, so if the
+ * file is truncated while it's being scanned, touching a page past its new
+ * end raises SIGBUS, even though the mapping is private.  Most headers and
+ * sources are small, so those are read into malloc'ed memory instead, which
+ * costs little and can't fail that way; only a file of MAP_MIN_SIZE or more is
+ * mapped, and one of those that shrinks while we read it still kills us.
+ */
+#include "c2man.h"
+#include "mapfile.h"
+
+#ifdef I_SYS_MMAN
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef I_FCNTL
+#include <fcntl.h>
+#endif
+#ifdef I_SYS_FILE
+#include <sys/file.h>
+#endif
+
+#if !defined(MAP_ANON) && defined(MAP_ANONYMOUS)
+#define MAP_ANON	MAP_ANONYMOUS
+#endif
+#ifndef MAP_FAILED
+#define MAP_FAILED	((void *)-1)
+#endif
+#endif
+
+/* the smallest file worth mapping rather than reading */
+#define MAP_MIN_SIZE	(256 * 1024L)
+
+#if defined(I_SYS_MMAN) && defined(MAP_ANON)
+/* read a small file into malloc'ed memory, followed by the two NULs.
+ * It may have shrunk since it was stat'ed, so len is set to what was read.
+ */
+static char *read_whole_file(fd, size, len)
+int fd;
+size_t size;
+size_t *len;
+{
+    char *base = (char *)safe_malloc(size + 2);
+    size_t got = 0;
+    int n;
+
+    while (got < size && (n = read(fd, base + got, size - got)) != 0)
+    {
+	if (n < 0)
+	{
+	    free(base);
+	    return NULL;
+	}
+	got += n;
+    }
+    base[got] = base[got + 1] = '\0';
+
+    *len = got;
+    return base;
+}
+#endif
+
+char *map_file(name, len)
+const char *name;
+size_t *len;
+{
+#if defined(I_SYS_MMAN) && defined(MAP_ANON)
+    struct stat statbuf;
+    char *base;
+    size_t size;
+    int fd;
+
+    if ((fd = open(name, O_RDONLY)) == -1)
+	return NULL;
+
+    /* an empty file can't be mapped, and anything but a plain file hasn't a
+     * size to go by.
+     */
+    if (fstat(fd, &statbuf) != 0 || (statbuf.st_mode & S_IFMT) != S_IFREG ||
+	statbuf.st_size == 0)
+    {
+	close(fd);
+	return NULL;
+    }
+    size = (size_t)statbuf.st_size;
+
+    if (statbuf.st_size < MAP_MIN_SIZE)
+    {
+	base = read_whole_file(fd, size, len);
+	close(fd);
+	return base;
+    }
+
+    base = (char *)mmap((void *)NULL, size + 2, PROT_READ | PROT_WRITE,
+					    MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (base == (char *)MAP_FAILED)
+    {
+	close(fd);
+	return NULL;
+    }
+    if (mmap((void *)base, size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)
+    {
+	munmap((void *)base, size + 2);
+	close(fd);
+	return NULL;
+    }
+    close(fd);
+
+    *len = size;
+    return base;
+#else
+    return NULL;
+#endif
+}
+
+/* a file read rather than mapped is still shorter than MAP_MIN_SIZE, even if
+ * it shrank
+ */
+void unmap_file(base, len)
+char *base;
+size_t len;
+{
+#if defined(I_SYS_MMAN) && defined(MAP_ANON)
+    if ((long)len < MAP_MIN_SIZE)
+	free(base);
+    else
+	munmap((void *)base, len + 2);
+#endif
+}
@@ -0,0 +1,20 @@
+/* $Id$
+ * map input files into memory, for the scanner to read in place
+ */
+#ifndef MAPFILE_H
+#define MAPFILE_H
+
+#include "c2man.h"
+
+/* map a file into memory, or read a small one in, followed by the two NULs
+ * that flex needs at the end of a buffer it scans in place.  The memory may
+ * be written to without changing the file.
+ * returns the start of it and sets len to the length of the file, or
+ * returns NULL if the file can't be mapped, when it should be read instead.
+ */
+char *map_file _((const char *name, size_t *len));
+
+/* unmap a file mapped by map_file */
+void unmap_file _((char *base, size_t len));
+
+#endif
@@ -0,0 +1,157 @@
+/* $Id$
+ *
+ * Count the allocations made, the frees, and the bytes live and at their
+ * peak, for each category of allocation, when built with -DMALLOC_STATS.
+ *
+ * Everything that includes c2man.h has malloc, realloc and free replaced
+ * with the versions here, which put a small header in front of each block
+ * to remember its size and category, so a free is counted against the
+ * category it was allocated under.
+ */
+#define MEMSTATS_C
+#include "c2man.h"
+
+#ifdef MALLOC_STATS
+
+/* the header on each block, padded to keep what follows aligned */
+typedef union AllocHeader
+{
+    struct
+    {
+	size_t size;
+	enum AllocCategory category;
+    } block;
+    double align_double;
+    long align_long;
+    void *align_pointer;
+} AllocHeader;
+
+typedef struct AllocStats
+{
+    long allocs;
+    long frees;
+    long live;
+    long peak;
+} AllocStats;
+
+static AllocStats stats[NUM_ALLOC_CATEGORIES];
+static long total_live = 0, total_peak = 0;
+
+static const char *category_names[NUM_ALLOC_CATEGORIES] =
+{
+    "other", "comments", "declarators", "pages", "enums", "output"
+};
+
+/* the categories begun but not yet ended */
+#define MAX_CATEGORY_DEPTH	16
+static enum AllocCategory category_stack[MAX_CATEGORY_DEPTH];
+static int category_depth = 0;
+
+void begin_alloc_category(category)
+enum AllocCategory category;
+{
+    if (category_depth < MAX_CATEGORY_DEPTH)
+	category_stack[category_depth] = category;
+    category_depth++;
+}
+
+void end_alloc_category()
+{
+    if (category_depth > 0)
+	category_depth--;
+}
+
+static enum AllocCategory current_category()
+{
+    if (category_depth == 0)
+	return ALLOC_OTHER;
+    if (category_depth > MAX_CATEGORY_DEPTH)
+	return category_stack[MAX_CATEGORY_DEPTH - 1];
+    return category_stack[category_depth - 1];
+}
+
+/* note that bytes have been allocated in a category */
+static void count_bytes(category, n)
+enum AllocCategory category;
+long n;
+{
+    AllocStats *s = &stats[category];
+
+    if ((s->live += n) > s->peak)
+	s->peak = s->live;
+    if ((total_live += n) > total_peak)
+	total_peak = total_live;
+}
+
+void *counted_malloc(size)
+size_t size;
+{
+    AllocHeader *h;
+
+    if ((h = (AllocHeader *)malloc(sizeof *h + size)) == NULL)
+	return NULL;
+
+    h->block.size = size;
+    h->block.category = current_category();
+    stats[h->block.category].allocs++;
+    count_bytes(h->block.category, (long)size);
+    return (void *)(h + 1);
+}
+
+void *counted_realloc(p, size)
+void *p;
+size_t size;
+{
+    AllocHeader *h;
+    size_t old_size;
+
+    if (p == NULL)
+	return counted_malloc(size);
+
+    h = (AllocHeader *)p - 1;
+    old_size = h->block.size;
+    if ((h = (AllocHeader *)realloc((void *)h, sizeof *h + size)) == NULL)
+	return NULL;
+
+    h->block.size = size;
+    count_bytes(h->block.category, (long)size - (long)old_size);
+    return (void *)(h + 1);
+}
+
+void counted_free(p)
+void *p;
+{
+    AllocHeader *h;
+
+    if (p == NULL)
+	return;
+
+    h = (AllocHeader *)p - 1;
+    stats[h->block.category].frees++;
+    count_bytes(h->block.category, -(long)h->block.size);
+    free((void *)h);
+}
+
+void report_malloc_stats()
+{
+    AllocStats total;
+    int i;
+
+    memset((char *)&total, 0, sizeof total);
+
+    fprintf(stderr, "%s: memory used:\n", progname);
+    fprintf(stderr, "  %-12s %10s %10s %12s %12s\n",
+		    "category", "allocs", "frees", "live bytes", "peak bytes");
+    for (i = 0; i < NUM_ALLOC_CATEGORIES; i++)
+    {
+	fprintf(stderr, "  %-12s %10ld %10ld %12ld %12ld\n", category_names[i],
+		stats[i].allocs, stats[i].frees, stats[i].live, stats[i].peak);
+	total.allocs += stats[i].allocs;
+	total.frees += stats[i].frees;
+    }
+
+    /* the peaks of the categories needn't have come at once */
+    fprintf(stderr, "  %-12s %10ld %10ld %12ld %12ld\n", "total",
+		    total.allocs, total.frees, total_live, total_peak);
+}
+#endif /* MALLOC_STATS */
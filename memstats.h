@@ -0,0 +1,39 @@
+/* $Id$
+ * count allocations by category, when built with -DMALLOC_STATS
+ */
+#ifndef MEMSTATS_H
+#define MEMSTATS_H
+
+/* what an allocation is for, as set by the code making it */
+enum AllocCategory
+{
+    ALLOC_OTHER,
+    ALLOC_COMMENTS,	/* the lexer's comment buffers */
+    ALLOC_DECLARATORS,	/* declarator text, and the rest built by the parser */
+    ALLOC_PAGES,	/* manual pages */
+    ALLOC_ENUMS,	/* enumerator lists */
+    ALLOC_OUTPUT,	/* strings made while writing the output */
+    NUM_ALLOC_CATEGORIES
+};
+
+/* count the allocations that follow under a category, until the matching
+ * end_alloc_category, when the category it interrupted carries on.
+ */
+void begin_alloc_category _((enum AllocCategory category));
+void end_alloc_category _((void));
+
+/* the counting versions of malloc, realloc and free */
+void *counted_malloc _((size_t size));
+void *counted_realloc _((void *p, size_t size));
+void counted_free _((void *p));
+
+/* report the counts for each category on the standard error */
+void report_malloc_stats _((void));
+
+#ifndef MEMSTATS_C
+#define malloc(size)		counted_malloc(size)
+#define realloc(p, size)	counted_realloc(p, size)
+#define free(p)			counted_free(p)
+#endif
+
+#endif
@@ -0,0 +1,223 @@
+/* $Id$
+ *
+ * Decide which input files can be read without the preprocessor, so already
+ * preprocessed files and simple headers needn't cost a process each.
+ *
+ * The scanner can follow #include "file" itself, and notes #defined names,
+ * but it can't expand macros or choose between conditional parts.  So a file
+ * is read directly only if all it and the files it includes ask for is that:
+ * quoted includes, macros without arguments, and pragmas, line directives and
+ * the like, with an include guard around the lot; system includes are
+ * allowed too if they're to be skipped.  Preprocessed files, named
+ * .i, are always read directly.
+ */
+#include "c2man.h"
+#include "strconcat.h"
+#include "nocpp.h"
+#include "catalog.h"
+
+#include <ctype.h>
+
+enum DirectInput direct_input = DIRECT_NEVER;
+
+/* how many directories have been added by add_include_dir */
+static int num_added_dirs = 0;
+
+boolean direct_input_option(arg)
+const char *arg;
+{
+    if (strcmp(arg, "auto") == 0)
+	direct_input = DIRECT_AUTO;
+    else if (strcmp(arg, "always") == 0)
+	direct_input = DIRECT_ALWAYS;
+    else if (strcmp(arg, "never") == 0)
+	direct_input = DIRECT_NEVER;
+    else
+	return FALSE;
+    return TRUE;
+}
+
+void add_include_dir(dir)
+const char *dir;
+{
+    int i;
+
+    if (num_inc_dir >= MAX_INC_DIR)
+    {
+	fprintf(stderr, "%s: too many include directories; ignoring %s\n",
+							    progname, dir);
+	return;
+    }
+
+    /* after the current directory and those added before, but ahead of the
+     * system directory.
+     */
+    for (i = num_inc_dir; i > 1 + num_added_dirs; i--)
+	inc_dir[i] = inc_dir[i - 1];
+    inc_dir[i] = strconcat(dir, "/", NULLCP);
+    num_inc_dir++;
+    num_added_dirs++;
+}
+
+/* copy the identifier at s into word, if there is one.
+ * returns a pointer past it.
+ */
+static const char *get_word(s, word)
+const char *s;
+char *word;
+{
+    int len = 0;
+
+    while (isalnum((unsigned char)*s) || *s == '_')
+    {
+	if (len < MAX_TEXT_LENGTH - 1)
+	    word[len++] = *s;
+	s++;
+    }
+    word[len] = '\0';
+    return s;
+}
+
+static boolean needs_cpp _((FILE *f, int depth));
+
+/* does a file #included by name need the preprocessor?  It's looked for
+ * where the scanner would look, and one that can't be found is left for the
+ * preprocessor to complain about.
+ */
+static boolean include_needs_cpp(name, depth)
+const char *name;
+int depth;
+{
+    char *path;
+    FILE *f;
+    int i;
+
+    if (depth >= MAX_INC_DEPTH)
+	return TRUE;
+
+    for (i = 0; i < num_inc_dir; i++)
+    {
+	path = strconcat(inc_dir[i], name, NULLCP);
+	f = fopen(path, "r");
+	free(path);
+	if (f != NULL)
+	    return needs_cpp(f, depth + 1);
+    }
+    return TRUE;
+}
+
+/* look through the directives in a file for anything only the preprocessor
+ * can deal with.  The file is closed afterwards.
+ */
+static boolean needs_cpp(f, depth)
+FILE *f;
+int depth;
+{
+    char line[BUFSIZ], word[MAX_TEXT_LENGTH], guard[MAX_TEXT_LENGTH];
+    const char *s;
+    boolean at_start = TRUE, need = FALSE;
+    int directives = 0;
+    enum { NO_GUARD, GUARD_STARTED, GUARDED, GUARD_ENDED } guard_state =
+								    NO_GUARD;
+
+    while (!need && fgets(line, sizeof line, f) != NULL)
+    {
+	/* only the start of a line can hold a directive */
+	s = line;
+	if (!at_start)
+	{
+	    at_start = strchr(line, '\n') != NULL;
+	    continue;
+	}
+	at_start = strchr(line, '\n') != NULL;
+
+	while (*s == ' ' || *s == '\t')	s++;
+	if (*s++ != '#')
+	    continue;
+	while (*s == ' ' || *s == '\t')	s++;
+
+	/* line markers are what a preprocessed file is made of */
+	if (isdigit((unsigned char)*s) || *s == '\n' || *s == '\0')
+	    continue;
+
+	s = get_word(s, word);
+	directives++;
+
+	/* the include guard must wrap everything else */
+	if (guard_state == GUARD_STARTED)
+	{
+	    char name_defined[MAX_TEXT_LENGTH];
+
+	    while (*s == ' ' || *s == '\t')	s++;
+	    get_word(s, name_defined);
+	    if (strcmp(word, "define") || strcmp(name_defined, guard))
+		need = TRUE;
+	    guard_state = GUARDED;
+	}
+	else if (guard_state == GUARD_ENDED)
+	    need = TRUE;
+	else if (strcmp(word, "ifndef") == 0 && directives == 1)
+	{
+	    while (*s == ' ' || *s == '\t')	s++;
+	    get_word(s, guard);
+	    guard_state = guard[0] ? GUARD_STARTED : NO_GUARD;
+	    need = guard[0] == '\0';
+	}
+	else if (strcmp(word, "endif") == 0 && guard_state == GUARDED)
+	    guard_state = GUARD_ENDED;
+	else if (strcmp(word, "define") == 0)
+	{
+	    /* a macro with arguments is bound to be used somewhere */
+	    while (*s == ' ' || *s == '\t')	s++;
+	    s = get_word(s, word);
+	    need = *s == '(';
+	}
+	else if (strcmp(word, "include") == 0)
+	{
+	    char *end;
+
+	    /* the system headers are full of conditionals, unless they're
+	     * to be skipped.
+	     */
+	    while (*s == ' ' || *s == '\t')	s++;
+	    if (*s == '<' && skip_system_headers)
+		continue;
+	    if (*s++ != '"' || (end = strchr(s, '"')) == NULL)
+		need = TRUE;
+	    else
+	    {
+		*end = '\0';
+		need = include_needs_cpp(s, depth);
+	    }
+	}
+	else if (strcmp(word, "pragma") && strcmp(word, "line") &&
+		 strcmp(word, "ident"))
+	    need = TRUE;
+    }
+
+    fclose(f);
+
+    /* a guard left open is as good as a conditional */
+    return need || guard_state == GUARD_STARTED || guard_state == GUARDED;
+}
+
+boolean read_directly(name)
+const char *name;
+{
+    size_t len = strlen(name);
+    FILE *f;
+
+    switch (direct_input)
+    {
+    case DIRECT_ALWAYS:
+	return TRUE;
+    case DIRECT_AUTO:
+	if (len > 2 && strcmp(name + len - 2, ".i") == 0)
+	    return TRUE;
+
+	/* if it can't be opened, let the preprocessor say so */
+	return (f = fopen(name, "r")) != NULL && !needs_cpp(f, 0);
+    default:
+	return FALSE;
+    }
+}
@@ -0,0 +1,34 @@
+/* $Id$
+ * decide which input files can be read without the preprocessor
+ */
+#ifndef NOCPP_H
+#define NOCPP_H
+
+#include "c2man.h"
+
+/* when to read input files directly instead of through the preprocessor */
+enum DirectInput
+{
+    DIRECT_NEVER,	/* always run the preprocessor */
+    DIRECT_AUTO,	/* read directly those that look like they can be */
+    DIRECT_ALWAYS	/* never run the preprocessor */
+};
+
+extern enum DirectInput direct_input;
+
+/* set when to read input files directly, from an option argument.
+ * Returns FALSE if it's no good.
+ */
+boolean direct_input_option _((const char *arg));
+
+/* should this input file be read directly, with the scanner following its
+ * #includes itself, rather than through the preprocessor?
+ */
+boolean read_directly _((const char *name));
+
+/* add a directory for the scanner to look for #included files in, before
+ * the system directory.
+ */
+void add_include_dir _((const char *dir));
+
+#endif
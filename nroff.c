@@ -21,13 +21,14 @@ const int c;
 
 void nroff_comment() { put_string(".\\\" "); }
 
-void nroff_header(firstpage, input_files, grouped, name, terse, section)
+void nroff_header(firstpage, input_files, grouped, name, terse, section, date)
 ManualPage *firstpage;
 int input_files;
 boolean grouped;
 const char *name;
 const char *terse;
 const char *section;
+Time_t date;
 {
 #ifdef HAS_STRFTIME
     char month[20];
@@ -37,7 +38,6 @@ const char *section;
     { "January", "February", "March", "April", "May", "June",
       "July", "August", "September", "October", "November", "December" };
 #endif
-    Time_t raw_time;
     struct tm *filetime;
     
     if (make_embeddable) return;
@@ -45,13 +45,8 @@ const char *section;
     output_warning();
     put_string(".TH \"");
 
-    /* if lots of files contributed, use the current time; otherwise use the
-     * time of the source file they came from.
-     */
-    raw_time = (grouped && input_files > 1) ? time((Time_t *)NULL)
-					    : firstpage->sourcetime;
-
-    filetime = localtime(&raw_time);
+    /* a date we were given is the same wherever we are */
+    filetime = date_given ? gmtime(&date) : localtime(&date);
 
 #ifdef HAS_STRFTIME
     /* generate the date format string */
@@ -25,9 +25,10 @@ struct Output
     /* comment until the end of the line */
     void (*comment) _((void));
 
-    /* header and introduction to the file */
+    /* header and introduction to the file, with the date the page is for */
     void (*header) _((ManualPage *firstpage, int input_files, boolean grouped,
-		    const char *name, const char *terse, const char *section));
+		    const char *name, const char *terse, const char *section,
+		    Time_t date));
     
     /* a dash */
     void (*dash) _((void));
@@ -0,0 +1,412 @@
+/* $Id$
+ *
+ * Write lists of manual pages to a stream and read them back, so pages parsed
+ * by a worker process can be handed back to its parent.
+ *
+ * Everything is written as text: integers one per line, and strings as their
+ * length, a colon, the characters themselves and a newline, or a lone "-" for
+ * a NULL pointer.
+ */
+#include "c2man.h"
+#include "manpage.h"
+#include "semantic.h"
+#include "enum.h"
+#include "serial.h"
+
+/* enumerator lists already passed through the current stream; a list shared
+ * by several declarations is only written once, and later referred to by its
+ * position in here.
+ */
+static EnumeratorList **enum_lists;
+static int num_enum_lists, max_enum_lists;
+
+static void remember_enum_list(list)
+EnumeratorList *list;
+{
+    if (num_enum_lists == max_enum_lists)
+    {
+	max_enum_lists = max_enum_lists ? max_enum_lists * 2 : 16;
+	if (enum_lists == NULL)
+	    enum_lists = (EnumeratorList **)
+			safe_malloc(max_enum_lists * sizeof *enum_lists);
+	else if ((enum_lists = (EnumeratorList **)realloc(enum_lists,
+			max_enum_lists * sizeof *enum_lists)) == NULL)
+	    outmem();
+    }
+    enum_lists[num_enum_lists++] = list;
+}
+
+void forget_enum_lists()
+{
+    safe_free(enum_lists);
+    num_enum_lists = max_enum_lists = 0;
+}
+
+void write_int(f, n)
+FILE *f;
+int n;
+{
+    fprintf(f, "%d\n", n);
+}
+
+void write_seconds(f, t)
+FILE *f;
+double t;
+{
+    fprintf(f, "%.6f\n", t);
+}
+
+void write_string(f, s)
+FILE *f;
+const char *s;
+{
+    if (s)
+	fprintf(f, "%lu:%s\n", (unsigned long)strlen(s), s);
+    else
+	fputs("-\n", f);
+}
+
+boolean read_int(f, n)
+FILE *f;
+int *n;
+{
+    return fscanf(f, "%d", n) == 1 && getc(f) == '\n';
+}
+
+boolean read_seconds(f, t)
+FILE *f;
+double *t;
+{
+    return fscanf(f, "%lf", t) == 1 && getc(f) == '\n';
+}
+
+boolean read_string(f, s)
+FILE *f;
+char **s;
+{
+    unsigned long len;
+    int c;
+
+    *s = NULL;
+    if ((c = getc(f)) == '-')
+	return getc(f) == '\n';
+    ungetc(c, f);
+
+    if (fscanf(f, "%lu:", &len) != 1)
+	return FALSE;
+
+    *s = (char *)safe_malloc((size_t)len + 1);
+    if (fread(*s, 1, (size_t)len, f) != len || getc(f) != '\n')
+    {
+	free(*s);
+	*s = NULL;
+	return FALSE;
+    }
+    (*s)[len] = '\0';
+    return TRUE;
+}
+
+/* an enumerator list is written as 0 for none, the (1-based) position of a
+ * list already written, or -1 followed by the list itself.
+ */
+void write_enum_list(f, list)
+FILE *f;
+EnumeratorList *list;
+{
+    Enumerator *e;
+    int i, count = 0;
+
+    if (list == NULL)
+    {
+	write_int(f, 0);
+	return;
+    }
+
+    for (i = 0; i < num_enum_lists; i++)
+	if (enum_lists[i] == list)
+	{
+	    write_int(f, i + 1);
+	    return;
+	}
+
+    remember_enum_list(list);
+    write_int(f, -1);
+
+    for (e = list->first; e; e = e->next)
+	count++;
+    write_int(f, count);
+
+    for (e = list->first; e; e = e->next)
+    {
+	write_string(f, e->name);
+	write_string(f, e->comment);
+	write_string(f, e->group_comment);
+    }
+}
+
+boolean read_enum_list(f, list)
+FILE *f;
+EnumeratorList **list;
+{
+    int ref, count, i;
+
+    *list = NULL;
+    if (!read_int(f, &ref))
+	return FALSE;
+
+    if (ref == 0)
+	return TRUE;
+
+    if (ref > 0)
+    {
+	if (ref > num_enum_lists)
+	    return FALSE;
+	*list = enum_lists[ref - 1];
+	return TRUE;
+    }
+
+    if (!read_int(f, &count) || count < 1)
+	return FALSE;
+
+    for (i = 0; i < count; i++)
+    {
+	Enumerator e;
+
+	if (!read_string(f, &e.name) || e.name == NULL ||
+	    !read_string(f, &e.comment) ||
+	    !read_string(f, &e.group_comment))
+	    return FALSE;
+
+	/* enumerator lists are owned by the global list in enum.c */
+	if (i == 0)
+	    *list = new_enumerator_list(&e);
+	else
+	    add_enumerator_list(*list, &e);
+    }
+
+    remember_enum_list(*list);
+    return TRUE;
+}
+
+static void write_decl_spec(f, decl_spec)
+FILE *f;
+DeclSpec *decl_spec;
+{
+    write_int(f, (int)decl_spec->flags);
+    write_string(f, decl_spec->text);
+    write_enum_list(f, decl_spec->enum_list);
+}
+
+static boolean read_decl_spec(f, decl_spec)
+FILE *f;
+DeclSpec *decl_spec;
+{
+    int flags;
+
+    decl_spec->text = NULL;
+    if (!read_int(f, &flags) ||
+	!read_string(f, &decl_spec->text) ||
+	!read_enum_list(f, &decl_spec->enum_list))
+    {
+	safe_free(decl_spec->text);
+	return FALSE;
+    }
+    decl_spec->flags = flags;
+    return TRUE;
+}
+
+/* write a declarator, along with its parameters and the stack of function
+ * declarators beneath it.  The head pointer is written as a depth down the
+ * function stack, since it always points to the declarator itself or to one
+ * on its stack.
+ */
+static void write_declarator(f, d)
+FILE *f;
+Declarator *d;
+{
+    Declarator *stack;
+    Parameter *p;
+    int depth = 0, count = 0;
+
+    for (stack = d; stack && stack != d->head; stack = stack->func_stack)
+	depth++;
+    if (stack == NULL)	depth = 0;
+
+    for (p = d->params.first; p; p = p->next)
+	count++;
+
+    write_string(f, d->name);
+    write_string(f, d->text);
+    write_int(f, (int)d->type);
+    write_string(f, d->comment);
+    write_string(f, d->retcomment);
+    write_int(f, depth);
+    write_int(f, count);
+
+    for (p = d->params.first; p; p = p->next)
+    {
+	write_decl_spec(f, &p->decl_spec);
+	write_declarator(f, p->declarator);
+	write_int(f, p->suppress);
+	write_int(f, p->duplicate);
+    }
+
+    write_int(f, d->func_stack != NULL);
+    if (d->func_stack)
+	write_declarator(f, d->func_stack);
+}
+
+static Declarator *read_declarator(f)
+FILE *f;
+{
+    Declarator *d, *stack;
+    char *name, *text;
+    int type, depth, count, has_stack, i;
+
+    if (!read_string(f, &name))
+	return NULL;
+    if (!read_string(f, &text))
+    {
+	safe_free(name);
+	return NULL;
+    }
+
+    d = new_declarator(text, name);
+
+    if (!read_int(f, &type) ||
+	!read_string(f, &d->comment) ||
+	!read_string(f, &d->retcomment) ||
+	!read_int(f, &depth) ||
+	!read_int(f, &count))
+    {
+	free_declarator(d);
+	return NULL;
+    }
+    d->type = (DeclType)type;
+
+    for (i = 0; i < count; i++)
+    {
+	Parameter p;
+
+	if (!read_decl_spec(f, &p.decl_spec))
+	{
+	    free_declarator(d);
+	    return NULL;
+	}
+	if ((p.declarator = read_declarator(f)) == NULL ||
+	    !read_int(f, &p.suppress) ||
+	    !read_int(f, &p.duplicate))
+	{
+	    free_decl_spec(&p.decl_spec);
+	    if (p.declarator)	free_declarator(p.declarator);
+	    free_declarator(d);
+	    return NULL;
+	}
+
+	if (i == 0)
+	    new_param_list(&d->params, &p);
+	else
+	    add_param_list(&d->params, &d->params, &p);
+    }
+
+    if (!read_int(f, &has_stack) ||
+	(has_stack && (d->func_stack = read_declarator(f)) == NULL))
+    {
+	free_declarator(d);
+	return NULL;
+    }
+
+    for (stack = d; stack && depth > 0; depth--)
+	stack = stack->func_stack;
+    d->head = stack ? stack : d;
+
+    return d;
+}
+
+/* write a list of manual pages, along with any terse description remembered
+ * while parsing them.
+ */
+boolean write_manual_pages(f, first, terse)
+FILE *f;
+ManualPage *first;
+const char *terse;
+{
+    ManualPage *page;
+    int count = 0;
+
+    for (page = first; page; page = page->next)
+	count++;
+    write_int(f, count);
+
+    for (page = first; page; page = page->next)
+    {
+	write_decl_spec(f, page->decl_spec);
+	write_declarator(f, page->declarator);
+	write_string(f, page->sourcefile);
+	fprintf(f, "%ld\n", (long)page->sourcetime);
+    }
+
+    write_string(f, terse);
+    forget_enum_lists();
+
+    return !ferror(f);
+}
+
+/* read back a list written by write_manual_pages */
+boolean read_manual_pages(f, terse)
+FILE *f;
+char **terse;
+{
+    int count, i;
+    boolean ok;
+
+    begin_alloc_category(ALLOC_PAGES);
+    *terse = NULL;
+    ok = read_int(f, &count);
+
+    for (i = 0; ok && i < count; i++)
+    {
+	ManualPage *page;
+	DeclSpec decl_spec;
+	Declarator *declarator;
+	long sourcetime;
+
+	if (!read_decl_spec(f, &decl_spec))
+	{
+	    ok = FALSE;
+	    break;
+	}
+	if ((declarator = read_declarator(f)) == NULL)
+	{
+	    free_decl_spec(&decl_spec);
+	    ok = FALSE;
+	    break;
+	}
+
+	page = (ManualPage *)safe_malloc(sizeof *page);
+	page->decl_spec = (DeclSpec *)safe_malloc(sizeof *page->decl_spec);
+	*page->decl_spec = decl_spec;
+	page->declarator = declarator;
+	page->first_section = NULL;
+	page->description = page->returns = NULL;
+	page->skip_output = FALSE;
+
+	if (!read_string(f, &page->sourcefile) ||
+	    fscanf(f, "%ld", &sourcetime) != 1 || getc(f) != '\n')
+	{
+	    free_manual_page(page);
+	    free(page);
+	    ok = FALSE;
+	    break;
+	}
+	page->sourcetime = (Time_t)sourcetime;
+
+	add_manual_page(page);
+    }
+
+    if (ok)	ok = read_string(f, terse);
+
+    forget_enum_lists();
+    end_alloc_category();
+    return ok;
+}
@@ -0,0 +1,38 @@
+/* $Id$
+ * pass lists of manual pages between processes
+ */
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include "manpage.h"
+
+/* write an integer, a number of seconds, or a string that may be NULL, in the
+ * same form as the manual pages, and read them back.  The readers return FALSE
+ * if the stream is corrupt; a string read is malloc'ed.
+ */
+void write_int _((FILE *f, int n));
+void write_seconds _((FILE *f, double t));
+void write_string _((FILE *f, const char *s));
+boolean read_int _((FILE *f, int *n));
+boolean read_seconds _((FILE *f, double *t));
+boolean read_string _((FILE *f, char **s));
+
+/* write an enumerator list that may be NULL, and read it back into the
+ * global list of them.  A list shared by several declarations is only written
+ * once to a stream, so forget_enum_lists must be called after the last.
+ */
+void write_enum_list _((FILE *f, EnumeratorList *list));
+boolean read_enum_list _((FILE *f, EnumeratorList **list));
+void forget_enum_lists _((void));
+
+/* write a list of manual pages, along with any terse description remembered
+ * while parsing them.  Returns FALSE on a write error.
+ */
+boolean write_manual_pages _((FILE *f, ManualPage *first, const char *terse));
+
+/* read back a list written by write_manual_pages, adding the pages to the
+ * end of the global list.  Returns FALSE if the stream is corrupt.
+ */
+boolean read_manual_pages _((FILE *f, char **terse));
+
+#endif
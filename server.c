@@ -0,0 +1,496 @@
+/* $Id$
+ *
+ * Run jobs for clients from a server listening on a Unix domain socket, to
+ * save starting a new process for each when there are many.
+ *
+ * A client sends its standard input, output and error over the socket, then
+ * its current directory and command line.  The server forks a process for
+ * each job, which changes to that directory, takes those as its own
+ * standard streams and runs the command line as if c2man had been started
+ * with it, so the pages go straight back to the client.  When it's done,
+ * its exit status is sent back to the client, which exits with it.
+ *
+ * Each job starts afresh from the server's own state, but what it learns of
+ * the headers it reads is kept: it sends the server a snapshot of what each
+ * defined (see snapshot.c), which the server reads back once the job is
+ * done, so the jobs forked after it have them in memory from the start, and
+ * needn't read those headers again unless they change.
+ *
+ * Since a job can run any preprocessor command it likes, only the user
+ * running the server may connect: the socket is made accessible to no one
+ * else, and the user at the other end of each connection is checked too, as
+ * not every system heeds a socket's permissions.
+ */
+#define _GNU_SOURCE		/* for struct ucred, with glibc */
+#include <errno.h>
+#include <signal.h>
+
+#include "c2man.h"
+#include "serial.h"
+#include "snapshot.h"
+#include "server.h"
+
+#ifdef USE_SERVER
+#ifdef I_FCNTL
+#include <fcntl.h>
+#endif
+#ifdef I_SYS_FILE
+#include <sys/file.h>
+#endif
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#define JOB_MAGIC	"c2man job 1\n"
+
+/* the socket we're listening on, to remove when we're killed */
+static const char *server_socket_name;
+
+/* the jobs still running, each with the file it sends its snapshots to and a
+ * pipe it writes a byte down when it's done, just before telling its client.
+ * Waiting for it to exit instead would leave the snapshots out of a job the
+ * same client sends straight after.
+ */
+typedef struct Job
+{
+    pid_t pid;
+    FILE *snapshots;
+    int done;
+} Job;
+
+static Job *jobs = NULL;
+static int num_jobs = 0, max_jobs_running = 0;
+
+/* fill in the address of a socket, if the name isn't too long for it */
+static boolean socket_address(addr, name)
+struct sockaddr_un *addr;
+const char *name;
+{
+    memset((char *)addr, 0, sizeof *addr);
+    addr->sun_family = AF_UNIX;
+    if (strlen(name) >= sizeof addr->sun_path)
+    {
+	fprintf(stderr, "%s: socket name too long: %s\n", progname, name);
+	return FALSE;
+    }
+    strcpy(addr->sun_path, name);
+    return TRUE;
+}
+
+/* is the client on a connection being run by the same user as us? */
+static boolean same_user(conn)
+int conn;
+{
+#ifdef HAS_GETPEEREID
+    uid_t uid;
+    gid_t gid;
+
+    return getpeereid(conn, &uid, &gid) == 0 && uid == geteuid();
+#else
+    struct ucred cred;
+    socklen_t len = sizeof cred;
+
+    return getsockopt(conn, SOL_SOCKET, SO_PEERCRED, (char *)&cred, &len) == 0
+	&& cred.uid == geteuid();
+#endif
+}
+
+/* send our standard input, output and error over a socket */
+static boolean send_streams(sock)
+int sock;
+{
+    struct msghdr msg;
+    struct iovec iov;
+    union
+    {
+	struct cmsghdr hdr;
+	char buf[CMSG_SPACE(3 * sizeof(int))];
+    } control;
+    struct cmsghdr *cmsg;
+    int fds[3];
+    char byte = 0;
+
+    fds[0] = 0;
+    fds[1] = 1;
+    fds[2] = 2;
+
+    /* there has to be something to carry them */
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+
+    memset((char *)&msg, 0, sizeof msg);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof control.buf;
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof fds);
+    memcpy(CMSG_DATA(cmsg), (char *)fds, sizeof fds);
+
+    return sendmsg(sock, &msg, 0) == 1;
+}
+
+/* receive a client's standard input, output and error from a socket */
+static boolean receive_streams(sock, fds)
+int sock;
+int fds[3];
+{
+    struct msghdr msg;
+    struct iovec iov;
+    union
+    {
+	struct cmsghdr hdr;
+	char buf[CMSG_SPACE(3 * sizeof(int))];
+    } control;
+    struct cmsghdr *cmsg;
+    char byte;
+
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+
+    memset((char *)&msg, 0, sizeof msg);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof control.buf;
+
+    if (recvmsg(sock, &msg, 0) != 1 ||
+	(cmsg = CMSG_FIRSTHDR(&msg)) == NULL ||
+	cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+	cmsg->cmsg_len != CMSG_LEN(3 * sizeof(int)))
+	return FALSE;
+
+    memcpy((char *)fds, CMSG_DATA(cmsg), 3 * sizeof(int));
+    return TRUE;
+}
+
+/* run a job from a client connected on a socket, with the server's options
+ * before its own, and send back its exit status, telling the server it's done
+ * first.
+ */
+static int run_job(conn, done, argc, argv)
+int conn;
+int done;
+int argc;
+char **argv;
+{
+    char magic[sizeof JOB_MAGIC], *cwd = NULL, **job_argv;
+    int fds[3], job_argc = 0, num, i, status;
+    boolean ok;
+    pid_t pid;
+    FILE *f;
+
+    if (!receive_streams(conn, fds))
+    {
+	fprintf(stderr, "%s: bad job from client\n", progname);
+	return 1;
+    }
+
+    if ((f = fdopen(dup(conn), "r")) == NULL)
+	outmem();
+    ok = fgets(magic, sizeof magic, f) &&
+	strcmp(magic, JOB_MAGIC) == 0 &&
+	read_string(f, &cwd) && cwd && read_int(f, &num) && num >= 0;
+
+    job_argv = (char **)safe_malloc((argc + (ok ? num : 0) + 1) *
+							    sizeof *job_argv);
+    for (i = 0; i < argc; i++)
+	job_argv[job_argc++] = argv[i];
+    for (i = 0; ok && i < num; i++)
+	ok = read_string(f, &job_argv[job_argc++]) &&
+					    job_argv[job_argc - 1] != NULL;
+    job_argv[job_argc] = NULL;
+
+    if (!ok)
+    {
+	fprintf(stderr, "%s: bad job from client\n", progname);
+	return 1;
+    }
+
+    if ((pid = fork()) == 0)
+    {
+	for (i = 0; i < 3; i++)
+	{
+	    dup2(fds[i], i);
+	    close(fds[i]);
+	}
+	fclose(f);
+	close(conn);
+	close(done);
+	signal(SIGPIPE, SIG_DFL);
+
+	if (chdir(cwd) == -1)
+	{
+	    my_perror("can't change to directory", cwd);
+	    exit(1);
+	}
+	exit(run_c2man(job_argc, job_argv));
+    }
+
+    for (i = 0; i < 3; i++)
+	close(fds[i]);
+
+    if (pid == -1)
+    {
+	my_perror("can't fork job in", cwd);
+	status = 1;
+    }
+    else if (waitpid(pid, &status, 0) == -1)
+	status = 1;
+    else if (WIFEXITED(status))
+	status = WEXITSTATUS(status);
+    else
+	status = 1;
+
+    write(done, "", 1);
+    close(done);
+
+    fclose(f);
+    if ((f = fdopen(conn, "w")) != NULL)
+    {
+	write_int(f, status);
+	fclose(f);
+    }
+    return 0;
+}
+
+/* note a job that has been started */
+static void add_job(pid, snapshots, done)
+pid_t pid;
+FILE *snapshots;
+int done;
+{
+    if (num_jobs == max_jobs_running)
+    {
+	max_jobs_running = max_jobs_running ? max_jobs_running * 2 : 8;
+	if (jobs == NULL)
+	    jobs = (Job *)safe_malloc(max_jobs_running * sizeof *jobs);
+	else if ((jobs = (Job *)realloc(jobs,
+				    max_jobs_running * sizeof *jobs)) == NULL)
+	    outmem();
+    }
+    jobs[num_jobs].pid = pid;
+    jobs[num_jobs].snapshots = snapshots;
+    jobs[num_jobs++].done = done;
+}
+
+/* tidy up after the jobs that have finished, keeping the snapshots they sent
+ * for the jobs to come.
+ */
+static void finish_jobs()
+{
+    char byte;
+    int i = 0;
+
+    while (i < num_jobs)
+    {
+	/* nothing to read yet means it's still running; the end of the pipe
+	 * means it died.
+	 */
+	if (read(jobs[i].done, &byte, 1) == -1 &&
+	    (errno == EAGAIN || errno == EINTR))
+	{
+	    i++;
+	    continue;
+	}
+
+	close(jobs[i].done);
+	waitpid(jobs[i].pid, (int *)NULL, 0);
+
+	if (jobs[i].snapshots)
+	{
+	    rewind(jobs[i].snapshots);
+	    keep_snapshots(jobs[i].snapshots);
+	    fclose(jobs[i].snapshots);
+	}
+	jobs[i] = jobs[--num_jobs];
+    }
+}
+
+/* remove the socket when we're told to stop */
+static Signal_t server_interrupt_handler(sig)
+int sig;
+{
+    unlink(server_socket_name);
+    exit(128 + sig);
+}
+
+int run_server(socket_name, argc, argv)
+const char *socket_name;
+int argc;
+char **argv;
+{
+    struct sockaddr_un addr;
+    int sock, conn, old_mask, done[2];
+    struct stat statbuf;
+    FILE *snapshots;
+    pid_t pid;
+
+    if (!socket_address(&addr, socket_name))
+	return 1;
+
+    if ((sock = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+    {
+	my_perror("can't create socket", socket_name);
+	return 1;
+    }
+
+    /* a socket left by a server that's gone can be replaced */
+    if (connect(sock, (struct sockaddr *)&addr, sizeof addr) == 0)
+    {
+	fprintf(stderr, "%s: a server is already listening on %s\n",
+						    progname, socket_name);
+	return 1;
+    }
+    close(sock);
+
+    /* but nothing else there is ours to remove */
+    if (lstat(socket_name, &statbuf) == 0)
+    {
+	if ((statbuf.st_mode & S_IFMT) != S_IFSOCK)
+	{
+	    fprintf(stderr, "%s: %s is there already, and isn't a socket\n",
+						    progname, socket_name);
+	    return 1;
+	}
+	unlink(socket_name);
+    }
+
+    /* no one else may connect to it */
+    old_mask = umask(077);
+    if ((sock = socket(AF_UNIX, SOCK_STREAM, 0)) == -1 ||
+	bind(sock, (struct sockaddr *)&addr, sizeof addr) == -1 ||
+	listen(sock, 16) == -1)
+    {
+	my_perror("can't listen on socket", socket_name);
+	umask(old_mask);
+	return 1;
+    }
+    umask(old_mask);
+
+    server_socket_name = socket_name;
+    signal(SIGINT, server_interrupt_handler);
+    signal(SIGTERM, server_interrupt_handler);
+    signal(SIGHUP, server_interrupt_handler);
+
+    /* a client going away mustn't take us with it */
+    signal(SIGPIPE, SIG_IGN);
+
+    for (;;)
+    {
+	if ((conn = accept(sock, (struct sockaddr *)NULL, NULL)) == -1)
+	{
+	    if (errno == EINTR)
+		continue;
+	    my_perror("error accepting job on", socket_name);
+	    break;
+	}
+
+	if (!same_user(conn))
+	{
+	    fprintf(stderr, "%s: refusing job from another user on %s\n",
+							progname, socket_name);
+	    close(conn);
+	    continue;
+	}
+
+	/* the job should start with everything the last ones learned */
+	finish_jobs();
+
+	if (pipe(done) == -1)
+	{
+	    my_perror("can't start job for", socket_name);
+	    close(conn);
+	    continue;
+	}
+
+	/* it's no loss if there's nowhere for it to send its snapshots */
+	snapshots = tmpfile();
+
+	switch (pid = fork())
+	{
+	case -1:
+	    my_perror("can't fork job for", socket_name);
+	    if (snapshots)	fclose(snapshots);
+	    close(done[0]);
+	    break;
+	case 0:
+	    close(sock);
+	    close(done[0]);
+	    signal(SIGINT, SIG_DFL);
+	    signal(SIGTERM, SIG_DFL);
+	    signal(SIGHUP, SIG_DFL);
+	    send_snapshots(snapshots);
+	    exit(run_job(conn, done[1], argc, argv));
+	default:
+	    fcntl(done[0], F_SETFL, O_NONBLOCK);
+	    add_job(pid, snapshots, done[0]);
+	    break;
+	}
+	close(done[1]);
+	close(conn);
+    }
+
+    unlink(socket_name);
+    return 1;
+}
+
+int run_client(socket_name, argc, argv)
+const char *socket_name;
+int argc;
+char **argv;
+{
+    struct sockaddr_un addr;
+    char cwd[1024];
+    int sock, status, i;
+    FILE *f;
+
+    if (!socket_address(&addr, socket_name) ||
+	(sock = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+	return -1;
+
+    if (connect(sock, (struct sockaddr *)&addr, sizeof addr) == -1)
+    {
+	close(sock);
+	return -1;
+    }
+
+    if (getcwd(cwd, sizeof cwd) == NULL)
+    {
+	my_perror("can't get current directory for", socket_name);
+	close(sock);
+	return 1;
+    }
+
+    if (!send_streams(sock) || (f = fdopen(dup(sock), "w")) == NULL)
+    {
+	my_perror("can't send job to", socket_name);
+	close(sock);
+	return 1;
+    }
+
+    fputs(JOB_MAGIC, f);
+    write_string(f, cwd);
+    write_int(f, argc - 1);
+    for (i = 1; i < argc; i++)
+	write_string(f, argv[i]);
+
+    if (fclose(f) == EOF || (f = fdopen(sock, "r")) == NULL)
+    {
+	my_perror("can't send job to", socket_name);
+	close(sock);
+	return 1;
+    }
+
+    if (!read_int(f, &status))
+    {
+	fprintf(stderr, "%s: lost server on %s\n", progname, socket_name);
+	status = 1;
+    }
+    fclose(f);
+    return status;
+}
+#endif /* USE_SERVER */
@@ -0,0 +1,36 @@
+/* $Id$
+ * run jobs for clients from a server listening on a Unix domain socket
+ */
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "c2man.h"
+
+#if defined(HAS_SOCKET) && defined(I_SYS_UN) && defined(HAS_FORK) && \
+    defined(HAS_WAITPID)
+#include <sys/socket.h>
+
+/* we need to be able to pass file descriptors over the socket, and to tell
+ * who's at the other end of it.
+ */
+#if defined(SCM_RIGHTS) && (defined(SO_PEERCRED) || defined(HAS_GETPEEREID))
+#define USE_SERVER
+#endif
+#endif
+
+#ifdef USE_SERVER
+/* listen on a socket for jobs, running each with the options given here
+ * followed by the client's own command line.  argv[0] is the program name.
+ * Only the user running the server can connect to it.
+ * Only returns in the event of failure.
+ */
+int run_server _((const char *socket_name, int argc, char **argv));
+
+/* have the server listening on a socket run a command line, with our
+ * standard input, output and error.  argv[0] is the program name.
+ * Returns the exit status of the job, or -1 if there's no server to run it.
+ */
+int run_client _((const char *socket_name, int argc, char **argv));
+#endif
+
+#endif
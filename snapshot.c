@@ -0,0 +1,611 @@
+/* $Id$
+ *
+ * Snapshots of what each header the scanner reads itself defines, kept in the
+ * cache between runs so the header needn't be read again.
+ *
+ * All the parser wants from a header is the type names and enums it defines,
+ * so while a header is read we note each as it's defined, along with every
+ * file read for it, and when it's done write them to a cache entry named
+ * after a hash of the header's name, the current directory and the options
+ * that affect how it's read.  Next time, if none of those files has been
+ * touched, the definitions are made straight from the snapshot instead.
+ *
+ * How the parser reads a header can depend on what was defined before it: it
+ * takes `T x;' one way if T is a type name and another if it isn't.  So each
+ * name looked up in a header that it hadn't defined itself is noted too,
+ * with whether it was a type name, and a snapshot is only replayed if each
+ * still is, or still isn't.
+ *
+ * A header read while the base file is open inside it, or with errors, isn't
+ * kept, as what the parser did with it can't be replayed.
+ *
+ * A server keeps the snapshots its jobs make in memory too, read back from a
+ * file each job sends them to, so the jobs it forks later start with them
+ * already read.
+ */
+#include "c2man.h"
+#include "strconcat.h"
+#include "strappend.h"
+#include "symbol.h"
+#include "enum.h"
+#include "serial.h"
+#include "depend.h"
+#include "cache.h"
+#include "catalog.h"
+#include "snapshot.h"
+
+#define SNAPSHOT_MAGIC	"c2man snapshot 2\n"
+
+/* the kinds of definition a snapshot records, along with the names it
+ * looked up
+ */
+enum { DEF_TYPEDEF, DEF_ENUM, DEF_SYSTEM, DEF_LOOKUP };
+
+typedef struct Definition
+{
+    int kind;
+    char *name;			/* NULL for DEF_SYSTEM */
+    int flags;			/* symbol flags for a type name, or for a
+				 * lookup, whether it found one */
+    EnumeratorList *list;	/* enumerators, if any */
+} Definition;
+
+/* a snapshot read back, with what's noted of each file read for it */
+typedef struct Snapshot
+{
+    char *key;
+    int num_files;
+    char **files;
+    FileStamp *stamps;
+    int num_defs;
+    Definition *defs;
+    struct Snapshot *next;	/* next kept in the same bucket */
+} Snapshot;
+
+/* the snapshots kept in memory, hashed on their keys */
+#define KEPT_HASH	251
+static Snapshot *kept[KEPT_HASH];
+
+/* where a server's job sends the snapshots it makes, if it is one, and
+ * whether it has stopped after failing to send one whole, as the server
+ * stops reading at one that isn't.
+ */
+static FILE *snapshot_stream = NULL;
+static boolean stream_failed = FALSE;
+
+/* everything defined, and every file read, since the outermost header being
+ * recorded was started.  Each header's are those from where it started on.
+ */
+static Definition *defs = NULL;
+static int num_defs = 0, max_defs = 0;
+static char **files = NULL;
+static int num_files = 0, max_files = 0;
+
+/* the headers being recorded, outermost first */
+typedef struct Recording
+{
+    char *path;
+    int first_def, first_file;
+    int errors;			/* errors when it was started */
+    Time_t since;		/* and when */
+    boolean good;		/* can it still be kept? */
+    SymbolTable *seen;		/* names defined or looked up in it */
+} Recording;
+
+static Recording recording[MAX_INC_DEPTH];
+static int num_recording = 0;
+
+/* are we making the definitions in a snapshot, so they're noted already? */
+static boolean replaying = FALSE;
+
+static void add_definition(kind, name, flags, list)
+int kind;
+char *name;
+int flags;
+EnumeratorList *list;
+{
+    if (num_defs == max_defs)
+    {
+	max_defs = max_defs ? max_defs * 2 : 64;
+	if (defs == NULL)
+	    defs = (Definition *)safe_malloc(max_defs * sizeof *defs);
+	else if ((defs = (Definition *)realloc(defs,
+					max_defs * sizeof *defs)) == NULL)
+	    outmem();
+    }
+    defs[num_defs].kind = kind;
+    defs[num_defs].name = name;
+    defs[num_defs].flags = flags;
+    defs[num_defs++].list = list;
+}
+
+static void add_file(name)
+char *name;
+{
+    if (num_files == max_files)
+    {
+	max_files = max_files ? max_files * 2 : 16;
+	if (files == NULL)
+	    files = (char **)safe_malloc(max_files * sizeof *files);
+	else if ((files = (char **)realloc(files,
+					max_files * sizeof *files)) == NULL)
+	    outmem();
+    }
+    files[num_files++] = name;
+}
+
+/* note that the headers being recorded have seen a name, so only the first
+ * lookup of it is kept.
+ */
+static void see_name(name)
+char *name;
+{
+    int i;
+
+    for (i = 0; i < num_recording; i++)
+	new_symbol(recording[i].seen, name, DS_NONE);
+}
+
+/* forget the definitions and files from one on */
+static void truncate_snapshots(def, file)
+int def, file;
+{
+    while (num_defs > def)
+    {
+	num_defs--;
+	safe_free(defs[num_defs].name);
+    }
+    while (num_files > file)
+	free(files[--num_files]);
+}
+
+/* the text a header's snapshot is only good for */
+static char *snapshot_key(path)
+const char *path;
+{
+    const char *cwd = current_dir();
+    char *key;
+    int i;
+
+    key = strconcat("snapshot\n", cwd ? cwd : "", "\n", path, "\n",
+		    skip_system_headers ? "skip system headers\n" : "",
+		    NULLCP);
+    for (i = 0; i < num_inc_dir; i++)
+	key = strappend(key, inc_dir[i], "\n", NULLCP);
+    return key;
+}
+
+/* make a definition recorded in a snapshot */
+static void define(def)
+Definition *def;
+{
+    Symbol *s;
+    int i;
+
+    switch (def->kind)
+    {
+    case DEF_TYPEDEF:
+	s = new_symbol(typedef_names, def->name, def->flags);
+	if (s && def->list)
+	{
+	    s->value.enum_list = def->list;
+	    s->valtype = SYMVAL_ENUM;
+	}
+	see_name(def->name);
+	break;
+    case DEF_ENUM:
+	add_enum_symbol(def->name, def->list);
+	break;
+    case DEF_SYSTEM:
+	add_catalog_typedefs(typedef_names);
+	for (i = 0; i < num_recording; i++)
+	    add_catalog_typedefs(recording[i].seen);
+	break;
+    case DEF_LOOKUP:
+	see_name(def->name);
+	break;
+    }
+}
+
+/* would the parser read a header the same way now as when its snapshot was
+ * made, starting from one of its definitions?  Each name it looked up must
+ * still be a type name, or still not be, given what it had defined by then.
+ */
+static boolean same_lookups(snap)
+Snapshot *snap;
+{
+    SymbolTable *defined = create_symbol_table();
+    boolean same = TRUE, found;
+    Definition *def;
+    int i;
+
+    for (i = 0; same && i < snap->num_defs; i++)
+	switch ((def = &snap->defs[i])->kind)
+	{
+	case DEF_TYPEDEF:
+	    new_symbol(defined, def->name, def->flags);
+	    break;
+	case DEF_SYSTEM:
+	    add_catalog_typedefs(defined);
+	    break;
+	case DEF_LOOKUP:
+	    found = find_symbol(defined, def->name) != NULL ||
+		    find_symbol(typedef_names, def->name) != NULL;
+	    same = found == (def->flags != 0);
+	    break;
+	}
+
+    destroy_symbol_table(defined);
+    return same;
+}
+
+/* can a snapshot stand in for its header now?  None of the files read for it
+ * may have changed since, or be the base file this time, and it must be read
+ * the same way.
+ */
+static boolean usable(snap)
+Snapshot *snap;
+{
+    const char *name;
+    int i;
+
+    for (i = 0; i < snap->num_files; i++)
+    {
+	name = snap->files[i];
+	if (file_changed(name, &snap->stamps[i]) ||
+	    is_base_file(strncmp(name, "./", 2) ? name : name + 2))
+	    return FALSE;
+    }
+    return same_lookups(snap);
+}
+
+static void free_snapshot(snap)
+Snapshot *snap;
+{
+    int i;
+
+    for (i = 0; i < snap->num_files; i++)
+	free(snap->files[i]);
+    for (i = 0; i < snap->num_defs; i++)
+	safe_free(snap->defs[i].name);
+    safe_free(snap->key);
+    safe_free(snap->files);
+    safe_free(snap->stamps);
+    safe_free(snap->defs);
+    free(snap);
+}
+
+/* read a snapshot back from a stream.
+ * Returns NULL if there isn't one there, or it's corrupt.
+ */
+static Snapshot *read_snapshot(f)
+FILE *f;
+{
+    char magic[sizeof SNAPSHOT_MAGIC];
+    Snapshot *snap;
+    Definition *def;
+    boolean ok;
+    int num, i;
+
+    if (!fgets(magic, sizeof magic, f) || strcmp(magic, SNAPSHOT_MAGIC) != 0)
+	return NULL;
+
+    snap = (Snapshot *)safe_malloc(sizeof *snap);
+    snap->key = NULL;
+    snap->num_files = snap->num_defs = 0;
+    snap->files = NULL;
+    snap->stamps = NULL;
+    snap->defs = NULL;
+
+    ok = read_string(f, &snap->key) && snap->key != NULL &&
+	read_int(f, &num) && num > 0;
+    if (ok)
+    {
+	snap->files = (char **)safe_malloc(num * sizeof *snap->files);
+	snap->stamps = (FileStamp *)safe_malloc(num * sizeof *snap->stamps);
+    }
+    for (i = 0; ok && i < num; i++)
+	if ((snap->files[i] = read_file_stamp(f, &snap->stamps[i])) != NULL)
+	    snap->num_files++;
+	else
+	    ok = FALSE;
+
+    ok = ok && read_int(f, &num) && num >= 0;
+    if (ok && num > 0)
+	snap->defs = (Definition *)safe_malloc(num * sizeof *snap->defs);
+    for (i = 0; ok && i < num; i++)
+    {
+	def = &snap->defs[i];
+	ok = read_int(f, &def->kind) &&
+	    def->kind >= DEF_TYPEDEF && def->kind <= DEF_LOOKUP &&
+	    read_string(f, &def->name);
+	if (ok)
+	{
+	    ok = (def->name != NULL || def->kind == DEF_SYSTEM) &&
+		read_int(f, &def->flags) && read_enum_list(f, &def->list);
+	    if (ok)
+		snap->num_defs++;
+	    else
+		safe_free(def->name);
+	}
+    }
+
+    forget_enum_lists();
+    if (!ok)
+    {
+	free_snapshot(snap);
+	return NULL;
+    }
+    return snap;
+}
+
+static unsigned int hash_key(key)
+const char *key;
+{
+    unsigned int h = 0;
+
+    while (*key)
+	h = (h << 1) ^ (unsigned char)*key++;
+    return h % KEPT_HASH;
+}
+
+/* look for a snapshot kept in memory */
+static Snapshot *find_kept(key)
+const char *key;
+{
+    Snapshot *snap;
+
+    for (snap = kept[hash_key(key)]; snap; snap = snap->next)
+	if (strcmp(snap->key, key) == 0)
+	    return snap;
+    return NULL;
+}
+
+boolean replay_snapshot(path)
+const char *path;
+{
+    char *key = snapshot_key(path), *entry;
+    Snapshot *snap, *from_cache = NULL;
+    FILE *f;
+    int i;
+
+    /* one kept in memory may be out of date, when the cache may have a newer
+     * one.
+     */
+    if ((snap = find_kept(key)) != NULL && !usable(snap))
+	snap = NULL;
+
+    if (snap == NULL && cache_dir)
+    {
+	entry = cache_key_entry(key);
+	if ((f = fopen(entry, "r")) != NULL)
+	{
+	    from_cache = read_snapshot(f);
+	    fclose(f);
+	}
+	free(entry);
+
+	/* the hash could collide, so the key must match in full */
+	if (from_cache && strcmp(from_cache->key, key) == 0 &&
+							usable(from_cache))
+	    snap = from_cache;
+    }
+    free(key);
+
+    if (snap)
+    {
+	if (verbose)
+	    fprintf(stderr, "%s: using snapshot of %s\n", progname, path);
+
+	replaying = TRUE;
+	for (i = 0; i < snap->num_defs; i++)
+	    define(&snap->defs[i]);
+	replaying = FALSE;
+
+	/* the headers being recorded around it read all it did */
+	if (num_recording > 0)
+	{
+	    for (i = 0; i < snap->num_files; i++)
+		add_file(strduplicate(snap->files[i]));
+	    for (i = 0; i < snap->num_defs; i++)
+		add_definition(snap->defs[i].kind,
+		    snap->defs[i].name ? strduplicate(snap->defs[i].name)
+				       : NULLCP,
+		    snap->defs[i].flags, snap->defs[i].list);
+	}
+    }
+
+    if (from_cache)	free_snapshot(from_cache);
+    return snap != NULL;
+}
+
+void begin_snapshot(path)
+const char *path;
+{
+    Recording *r = &recording[num_recording++];
+
+    r->path = strduplicate(path);
+    r->first_def = num_defs;
+    r->first_file = num_files;
+    r->errors = errors;
+    r->since = time((Time_t *)NULL);
+    r->good = TRUE;
+    r->seen = create_symbol_table();
+    add_file(strduplicate(path));
+}
+
+/* write a header's snapshot to a stream.
+ * Returns FALSE if one of its files has gone.
+ */
+static boolean write_snapshot(f, key, r)
+FILE *f;
+const char *key;
+Recording *r;
+{
+    boolean ok = TRUE;
+    int i;
+
+    fputs(SNAPSHOT_MAGIC, f);
+    write_string(f, key);
+
+    write_int(f, num_files - r->first_file);
+    for (i = r->first_file; ok && i < num_files; i++)
+	ok = write_file_stamp(f, files[i]);
+
+    write_int(f, num_defs - r->first_def);
+    for (i = r->first_def; i < num_defs; i++)
+    {
+	write_int(f, defs[i].kind);
+	write_string(f, defs[i].name);
+	write_int(f, defs[i].flags);
+	write_enum_list(f, defs[i].list);
+    }
+    forget_enum_lists();
+    return ok;
+}
+
+/* were none of a header's files modified while it was being read?  One
+ * that was could have been read as it was before or after, so its stamp
+ * now can't be trusted.
+ */
+static boolean settled(r)
+Recording *r;
+{
+    int i;
+
+    for (i = r->first_file; i < num_files; i++)
+	if (touched_since(files[i], r->since))
+	    return FALSE;
+    return TRUE;
+}
+
+/* write a header's snapshot to the cache, and send it to the server */
+static void store_snapshot(r)
+Recording *r;
+{
+    char *key = snapshot_key(r->path);
+    char *entry, *temp_name;
+    FILE *f;
+
+    if (cache_dir)
+    {
+	entry = cache_key_entry(key);
+	if ((f = cache_create(entry, &temp_name)) != NULL)
+	    cache_commit(f, entry, temp_name,
+			 write_snapshot(f, key, r) && !ferror(f));
+	free(entry);
+    }
+
+    if (snapshot_stream && !stream_failed &&
+	(!write_snapshot(snapshot_stream, key, r) ||
+	 fflush(snapshot_stream) == EOF))
+	stream_failed = TRUE;
+
+    free(key);
+}
+
+void end_snapshot()
+{
+    Recording *r;
+
+    if (num_recording == 0)
+	return;
+
+    r = &recording[--num_recording];
+    if (r->good && errors == r->errors && settled(r))
+	store_snapshot(r);
+    free(r->path);
+    destroy_symbol_table(r->seen);
+
+    /* the outermost header needs nothing kept */
+    if (num_recording == 0)
+	truncate_snapshots(0, 0);
+}
+
+boolean snapshots_wanted()
+{
+    return cache_dir != NULL || snapshot_stream != NULL;
+}
+
+void send_snapshots(f)
+FILE *f;
+{
+    snapshot_stream = f;
+}
+
+void keep_snapshots(f)
+FILE *f;
+{
+    Snapshot *snap, **bucket, **p;
+
+    while ((snap = read_snapshot(f)) != NULL)
+    {
+	/* a new one replaces any kept before */
+	bucket = &kept[hash_key(snap->key)];
+	for (p = bucket; *p; p = &(*p)->next)
+	    if (strcmp((*p)->key, snap->key) == 0)
+	    {
+		Snapshot *old = *p;
+
+		*p = old->next;
+		free_snapshot(old);
+		break;
+	    }
+
+	snap->next = *bucket;
+	*bucket = snap;
+    }
+}
+
+void abandon_snapshots()
+{
+    int i;
+
+    for (i = 0; i < num_recording; i++)
+	recording[i].good = FALSE;
+}
+
+void note_typedef_symbol(name, flags, list)
+char *name;
+int flags;
+EnumeratorList *list;
+{
+    if (num_recording && !replaying)
+    {
+	add_definition(DEF_TYPEDEF, strduplicate(name), flags, list);
+	see_name(name);
+    }
+}
+
+void note_enum_symbol(name, list)
+char *name;
+EnumeratorList *list;
+{
+    if (num_recording && !replaying)
+	add_definition(DEF_ENUM, strduplicate(name), 0, list);
+}
+
+void note_system_include()
+{
+    int i;
+
+    if (num_recording && !replaying)
+    {
+	add_definition(DEF_SYSTEM, NULLCP, 0, (EnumeratorList *)NULL);
+	for (i = 0; i < num_recording; i++)
+	    add_catalog_typedefs(recording[i].seen);
+    }
+}
+
+void note_type_lookup(name, found)
+char *name;
+boolean found;
+{
+    if (num_recording && !replaying &&
+	find_symbol(recording[num_recording - 1].seen, name) == NULL)
+    {
+	add_definition(DEF_LOOKUP, strduplicate(name), (int)found,
+						    (EnumeratorList *)NULL);
+	see_name(name);
+    }
+}
@@ -0,0 +1,53 @@
+/* $Id$
+ * keep snapshots in the cache of the type names and enums each header the
+ * scanner reads defines
+ */
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "c2man.h"
+
+/* should snapshots be used and made?  They're kept in the cache, or sent
+ * to a server.
+ */
+boolean snapshots_wanted _((void));
+
+/* if there's a snapshot of a header that's still good, kept in memory or in
+ * the cache, define everything it records in place of reading the header.
+ * Returns FALSE if the header must be read.
+ */
+boolean replay_snapshot _((const char *path));
+
+/* start and finish recording what's defined while reading a header, to keep
+ * a snapshot of it when it's done.  They nest with the headers.
+ */
+void begin_snapshot _((const char *path));
+void end_snapshot _((void));
+
+/* send each snapshot made to a stream as well, for a server to keep */
+void send_snapshots _((FILE *f));
+
+/* keep the snapshots sent to a stream in memory, to be used in place of
+ * those in the cache.
+ */
+void keep_snapshots _((FILE *f));
+
+/* don't keep snapshots of the headers being read, since something in them
+ * can't be replayed.
+ */
+void abandon_snapshots _((void));
+
+/* note what's being defined, for the snapshots being recorded: a type name,
+ * from a typedef or a #define, an enum, and a system header's standing in
+ * for by the catalog.
+ */
+void note_typedef_symbol _((char *name, int flags, EnumeratorList *list));
+void note_enum_symbol _((char *name, EnumeratorList *list));
+void note_system_include _((void));
+
+/* note a name being looked up, and whether it's a type name, for the
+ * snapshots being recorded.
+ */
+void note_type_lookup _((char *name, boolean found));
+
+#endif
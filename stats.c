@@ -0,0 +1,418 @@
+/* $Id$
+ *
+ * Keep statistics on where the time goes: the wall clock and CPU time spent
+ * in each phase, and counts of what was read, lexed and written, for each
+ * input file and for the run as a whole.
+ *
+ * The phases nest, as the parser calls the scanner, which reads from the
+ * preprocessor, so we keep a stack of them and charge the time between each
+ * change to the phase on top.  The CPU time of the preprocessor, as a child
+ * process, is charged to the cpp phase when it's waited for.
+ */
+#include "c2man.h"
+#include "serial.h"
+#include "stats.h"
+
+#if defined(HAS_GETRUSAGE) && defined(I_SYS_RESOURCE)
+#include <sys/resource.h>
+#endif
+
+boolean keep_stats = FALSE;
+
+/* how to report them, and where */
+static boolean stats_json;
+static const char *stats_file_name;
+
+static const char *phase_names[NUM_PHASES] =
+{
+    "cpp", "scan", "parse", "split", "output"
+};
+
+static const char *count_names[NUM_COUNTS] =
+{
+    "bytes_read", "tokens", "comments", "pages", "bytes_written"
+};
+
+static const char *count_text[NUM_COUNTS] =
+{
+    "bytes read", "tokens", "comments", "pages", "bytes written"
+};
+
+/* the statistics for an input file */
+typedef struct FileStats
+{
+    char *name;
+    double wall[NUM_PHASES];
+    double cpu[NUM_PHASES];
+    long count[NUM_COUNTS];
+} FileStats;
+
+static FileStats *files = NULL;
+static int num_files = 0, max_files = 0;
+
+/* the one being charged, if any */
+static FileStats *current = NULL;
+
+/* statistics for anything done before the first input file */
+static FileStats no_file;
+
+/* the phases entered but not yet left */
+#define MAX_PHASE_DEPTH	16
+static enum StatsPhase phase_stack[MAX_PHASE_DEPTH];
+static int phase_depth = 0;
+
+/* the clocks at the last change, and when the run started */
+static double last_wall, last_cpu, last_children, run_started;
+
+boolean stats_option(arg)
+const char *arg;
+{
+    const char *colon = strchr(arg, ':');
+    size_t len = colon ? colon - arg : strlen(arg);
+
+    if (len == 4 && strncmp(arg, "text", 4) == 0)
+	stats_json = FALSE;
+    else if (len == 4 && strncmp(arg, "json", 4) == 0)
+	stats_json = TRUE;
+    else
+	return FALSE;
+
+    stats_file_name = colon && colon[1] ? colon + 1 : NULL;
+    keep_stats = TRUE;
+    return TRUE;
+}
+
+/* the time now, in seconds */
+static double wall_time()
+{
+#if defined(HAS_GETTIMEOFDAY) && defined(I_SYS_TIME)
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+#else
+    return (double)time((time_t *)NULL);
+#endif
+}
+
+#if defined(HAS_GETRUSAGE) && defined(I_SYS_RESOURCE)
+/* the CPU time used by us, or by the children we've waited for */
+static double rusage_time(who)
+int who;
+{
+    struct rusage usage;
+
+    if (getrusage(who, &usage) == -1)
+	return 0;
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1000000.0 +
+	   usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1000000.0;
+}
+
+#define cpu_time()	rusage_time(RUSAGE_SELF)
+#define children_time()	rusage_time(RUSAGE_CHILDREN)
+#else
+#define cpu_time()	((double)clock() / CLOCKS_PER_SEC)
+#define children_time()	0.0
+#endif
+
+void start_stats()
+{
+    if (!keep_stats)
+	return;
+
+    run_started = last_wall = wall_time();
+    last_cpu = cpu_time();
+}
+
+/* charge the time since the last change to the phase on top of the stack */
+static void charge_time()
+{
+    double wall = wall_time(), cpu = cpu_time();
+    FileStats *stats = current ? current : &no_file;
+
+    if (phase_depth > 0)
+    {
+	enum StatsPhase phase = phase_stack[phase_depth - 1];
+
+	stats->wall[phase] += wall - last_wall;
+	stats->cpu[phase] += cpu - last_cpu;
+    }
+    last_wall = wall;
+    last_cpu = cpu;
+}
+
+/* find the statistics for a file, adding them if they're not there */
+static FileStats *find_file(name)
+const char *name;
+{
+    int i;
+
+    if (current && strcmp(current->name, name) == 0)
+	return current;
+
+    for (i = num_files; --i >= 0; )
+	if (strcmp(files[i].name, name) == 0)
+	    return &files[i];
+
+    if (num_files == max_files)
+    {
+	int offset = current ? current - files : -1;
+
+	max_files = max_files ? max_files * 2 : 64;
+	if (files == NULL)
+	    files = (FileStats *)safe_malloc(max_files * sizeof *files);
+	else if ((files = (FileStats *)realloc(files,
+				    max_files * sizeof *files)) == NULL)
+	    outmem();
+	if (offset >= 0)	current = &files[offset];
+    }
+
+    memset((char *)&files[num_files], 0, sizeof *files);
+    files[num_files].name = strduplicate(name);
+    return &files[num_files++];
+}
+
+void stats_file(name)
+const char *name;
+{
+    if (!keep_stats)
+	return;
+
+    charge_time();
+    current = name ? find_file(name) : NULL;
+}
+
+void stats_enter(phase)
+enum StatsPhase phase;
+{
+    if (!keep_stats)
+	return;
+
+    charge_time();
+    if (phase == PHASE_CPP)
+	last_children = children_time();
+    if (phase_depth < MAX_PHASE_DEPTH)
+	phase_stack[phase_depth] = phase;
+    phase_depth++;
+}
+
+void stats_leave()
+{
+    if (!keep_stats || phase_depth == 0)
+	return;
+
+    charge_time();
+    if (--phase_depth < MAX_PHASE_DEPTH &&
+	phase_stack[phase_depth] == PHASE_CPP)
+    {
+	FileStats *stats = current ? current : &no_file;
+	double children = children_time();
+
+	stats->cpu[PHASE_CPP] += children - last_children;
+	last_children = children;
+    }
+}
+
+void stats_count(what, n)
+enum StatsCount what;
+long n;
+{
+    if (keep_stats)
+	(current ? current : &no_file)->count[what] += n;
+}
+
+void forget_stats()
+{
+    int i;
+
+    for (i = 0; i < num_files; i++)
+	free(files[i].name);
+    num_files = 0;
+    current = NULL;
+    memset((char *)&no_file, 0, sizeof no_file);
+}
+
+/* times are passed in seconds, to the microsecond */
+void write_stats(f)
+FILE *f;
+{
+    int i, j;
+
+    write_int(f, num_files);
+    for (i = 0; i < num_files; i++)
+    {
+	write_string(f, files[i].name);
+	for (j = 0; j < NUM_PHASES; j++)
+	{
+	    write_seconds(f, files[i].wall[j]);
+	    write_seconds(f, files[i].cpu[j]);
+	}
+	for (j = 0; j < NUM_COUNTS; j++)
+	    write_int(f, (int)files[i].count[j]);
+    }
+}
+
+boolean read_stats(f)
+FILE *f;
+{
+    FileStats *stats;
+    char *name;
+    double wall, cpu;
+    int num, i, j, n;
+
+    if (!read_int(f, &num) || num < 0)
+	return FALSE;
+
+    for (i = 0; i < num; i++)
+    {
+	if (!read_string(f, &name) || name == NULL)
+	    return FALSE;
+	stats = find_file(name);
+	free(name);
+
+	for (j = 0; j < NUM_PHASES; j++)
+	{
+	    if (!read_seconds(f, &wall) || !read_seconds(f, &cpu))
+		return FALSE;
+	    stats->wall[j] += wall;
+	    stats->cpu[j] += cpu;
+	}
+	for (j = 0; j < NUM_COUNTS; j++)
+	{
+	    if (!read_int(f, &n))
+		return FALSE;
+	    stats->count[j] += n;
+	}
+    }
+    return TRUE;
+}
+
+/* add up the statistics for one file into a total */
+static void add_stats(total, stats)
+FileStats *total;
+const FileStats *stats;
+{
+    int i;
+
+    for (i = 0; i < NUM_PHASES; i++)
+    {
+	total->wall[i] += stats->wall[i];
+	total->cpu[i] += stats->cpu[i];
+    }
+    for (i = 0; i < NUM_COUNTS; i++)
+	total->count[i] += stats->count[i];
+}
+
+static void print_text(f, title, stats)
+FILE *f;
+const char *title;
+const FileStats *stats;
+{
+    double wall = 0, cpu = 0;
+    int i;
+
+    fprintf(f, "%s:\n", title);
+    fprintf(f, "  %-8s %10s %10s\n", "phase", "wall", "cpu");
+    for (i = 0; i < NUM_PHASES; i++)
+    {
+	fprintf(f, "  %-8s %10.6f %10.6f\n", phase_names[i],
+						stats->wall[i], stats->cpu[i]);
+	wall += stats->wall[i];
+	cpu += stats->cpu[i];
+    }
+    fprintf(f, "  %-8s %10.6f %10.6f\n", "total", wall, cpu);
+
+    for (i = 0; i < NUM_COUNTS; i++)
+	fprintf(f, "%s%ld %s", i ? ", " : "  ", stats->count[i],
+								count_text[i]);
+    putc('\n', f);
+}
+
+static void print_json_string(f, s)
+FILE *f;
+const char *s;
+{
+    putc('"', f);
+    for (; *s; s++)
+    {
+	if (*s == '"' || *s == '\\')
+	    fprintf(f, "\\%c", *s);
+	else if ((unsigned char)*s < ' ')
+	    fprintf(f, "\\u%04x", (unsigned char)*s);
+	else
+	    putc(*s, f);
+    }
+    putc('"', f);
+}
+
+/* print the members of a JSON object for the statistics */
+static void print_json(f, stats)
+FILE *f;
+const FileStats *stats;
+{
+    int i;
+
+    fputs("\"phases\": {", f);
+    for (i = 0; i < NUM_PHASES; i++)
+	fprintf(f, "%s\"%s\": {\"wall\": %.6f, \"cpu\": %.6f}",
+		i ? ", " : "", phase_names[i], stats->wall[i], stats->cpu[i]);
+    putc('}', f);
+
+    for (i = 0; i < NUM_COUNTS; i++)
+	fprintf(f, ", \"%s\": %ld", count_names[i], stats->count[i]);
+}
+
+void report_stats()
+{
+    FileStats total;
+    double run_time;
+    FILE *f = stderr;
+    int i;
+
+    if (!keep_stats)
+	return;
+
+    run_time = wall_time() - run_started;
+
+    if (stats_file_name && (f = fopen(stats_file_name, "w")) == NULL)
+    {
+	my_perror("can't write statistics to", stats_file_name);
+	return;
+    }
+
+    memset((char *)&total, 0, sizeof total);
+    add_stats(&total, &no_file);
+    for (i = 0; i < num_files; i++)
+	add_stats(&total, &files[i]);
+
+    if (stats_json)
+    {
+	fputs("{\n  \"files\": [", f);
+	for (i = 0; i < num_files; i++)
+	{
+	    fputs(i ? ",\n    {\"name\": " : "\n    {\"name\": ", f);
+	    print_json_string(f, files[i].name);
+	    fputs(", ", f);
+	    print_json(f, &files[i]);
+	    putc('}', f);
+	}
+	fprintf(f, "\n  ],\n  \"total\": {\"files\": %d, \"wall\": %.6f, ",
+							num_files, run_time);
+	print_json(f, &total);
+	fputs("}\n}\n", f);
+    }
+    else
+    {
+	char title[80];
+
+	for (i = 0; i < num_files; i++)
+	    print_text(f, files[i].name, &files[i]);
+
+	sprintf(title, "all %d file%s, %.6f seconds", num_files,
+				num_files == 1 ? "" : "s", run_time);
+	print_text(f, title, &total);
+    }
+
+    if (f != stderr && fclose(f) == EOF)
+	my_perror("error writing statistics to", stats_file_name);
+}
@@ -0,0 +1,68 @@
+/* $Id$
+ * statistics on where the time goes, per input file and in aggregate
+ */
+#ifndef STATS_H
+#define STATS_H
+
+#include "c2man.h"
+
+/* the phases the time is divided between */
+enum StatsPhase
+{
+    PHASE_CPP,		/* running the preprocessor and reading its output */
+    PHASE_SCAN,		/* the lexical scanner */
+    PHASE_PARSE,	/* the parser, less the scanner */
+    PHASE_SPLIT,	/* splitting up the comments */
+    PHASE_OUTPUT,	/* the output backends, less the splitting */
+    NUM_PHASES
+};
+
+/* the things counted */
+enum StatsCount
+{
+    COUNT_BYTES_READ,		/* from the preprocessor */
+    COUNT_TOKENS,		/* lexed */
+    COUNT_COMMENTS,		/* captured */
+    COUNT_PAGES,		/* generated */
+    COUNT_BYTES_WRITTEN,	/* to the output files */
+    NUM_COUNTS
+};
+
+/* are we keeping statistics? */
+extern boolean keep_stats;
+
+/* set how the statistics are reported from a -z argument, format[:file].
+ * Returns FALSE if it's no good.
+ */
+boolean stats_option _((const char *arg));
+
+/* start keeping statistics for a run */
+void start_stats _((void));
+
+/* account what follows to an input file */
+void stats_file _((const char *name));
+
+/* account what follows to a phase, until the matching stats_leave, when the
+ * phase it interrupted carries on.
+ */
+void stats_enter _((enum StatsPhase phase));
+void stats_leave _((void));
+
+/* add to a count for the current input file */
+void stats_count _((enum StatsCount what, long n));
+
+/* forget the statistics gathered so far, in a process forked to do some of
+ * the work, so only its own are passed back.
+ */
+void forget_stats _((void));
+
+/* pass the statistics gathered between processes, adding those read to our
+ * own.  The reader returns FALSE if the stream is corrupt.
+ */
+void write_stats _((FILE *f));
+boolean read_stats _((FILE *f));
+
+/* report the statistics for the run, if we're keeping them */
+void report_stats _((void));
+
+#endif
@@ -74,13 +74,15 @@ const char *text;
 
 void texinfo_comment() { put_string("@c "); }
 
-void texinfo_header(firstpage, input_files, grouped, name, terse, section)
+void texinfo_header(firstpage, input_files, grouped, name, terse, section,
+									date)
 ManualPage *firstpage;
 int input_files;
 boolean grouped;
 const char *name;
 const char *terse;
 const char *section;
+Time_t date;
 {
     if (! make_embeddable)
     {
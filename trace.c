@@ -0,0 +1,119 @@
+/* $Id$
+ *
+ * Write a trace of the run in the trace event format read by Chrome's trace
+ * viewer and the like: a JSON array of events, each a span of time given
+ * as its start and duration in microseconds.
+ *
+ * The worker processes started by -j inherit the trace file and add their
+ * own spans to it.  It's opened for appending, and each event is written as a
+ * line of its own in one go, so theirs don't get mixed up with ours.  They
+ * all show as threads of the one process, as do the preprocessor runs, so a
+ * preprocessor started ahead of the parser gets a track of its own.
+ */
+#include "c2man.h"
+#include "trace.h"
+
+boolean tracing = FALSE;
+
+static FILE *trace_file;
+static const char *trace_file_name;
+
+/* the process the trace is for, and the time it started */
+static int trace_pid;
+static double trace_started;
+
+/* the time now, in microseconds */
+static double time_now()
+{
+#if defined(HAS_GETTIMEOFDAY) && defined(I_SYS_TIME)
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000.0 + tv.tv_usec;
+#else
+    return (double)time((time_t *)NULL) * 1000000.0;
+#endif
+}
+
+boolean start_trace(name)
+const char *name;
+{
+    FILE *f;
+
+    /* start the array afresh, then add to it */
+    if ((f = fopen(name, "w")) == NULL || fputs("[\n", f) == EOF ||
+	fclose(f) == EOF || (trace_file = fopen(name, "a")) == NULL)
+    {
+	my_perror("can't write trace to", name);
+	return FALSE;
+    }
+    setvbuf(trace_file, (char *)NULL, _IOLBF, BUFSIZ);
+
+    trace_file_name = name;
+    trace_pid = getpid();
+    trace_started = time_now();
+    tracing = TRUE;
+    return TRUE;
+}
+
+double trace_time()
+{
+    return tracing ? time_now() : 0;
+}
+
+static void put_json_string(s)
+const char *s;
+{
+    putc('"', trace_file);
+    for (; *s; s++)
+    {
+	if (*s == '"' || *s == '\\')
+	    fprintf(trace_file, "\\%c", *s);
+	else if ((unsigned char)*s < ' ')
+	    fprintf(trace_file, "\\u%04x", (unsigned char)*s);
+	else
+	    putc(*s, trace_file);
+    }
+    putc('"', trace_file);
+}
+
+void trace_span(name, category, arg_name, detail, started, pid)
+const char *name;
+const char *category;
+const char *arg_name;
+const char *detail;
+double started;
+int pid;
+{
+    if (!tracing)
+	return;
+
+    fprintf(trace_file,
+	"{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.0f, "
+	"\"dur\": %.0f, \"pid\": %d, \"tid\": %d", name, category,
+	started - trace_started, time_now() - started, trace_pid,
+	pid ? pid : (int)getpid());
+    if (detail)
+    {
+	fprintf(trace_file, ", \"args\": {\"%s\": ", arg_name);
+	put_json_string(detail);
+	putc('}', trace_file);
+    }
+    fputs("},\n", trace_file);
+}
+
+void end_trace()
+{
+    if (!tracing)
+	return;
+
+    /* the last event has no comma after it */
+    fprintf(trace_file,
+	"{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, "
+	"\"args\": {\"name\": ", trace_pid);
+    put_json_string(progname);
+    fputs("}}\n]\n", trace_file);
+    if (fclose(trace_file) == EOF)
+	my_perror("error writing trace to", trace_file_name);
+    tracing = FALSE;
+}
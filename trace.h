@@ -0,0 +1,31 @@
+/* $Id$
+ * write a trace of the run for a trace viewer, in Chrome's trace event format
+ */
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "c2man.h"
+
+/* are we writing a trace? */
+extern boolean tracing;
+
+/* start writing a trace of the run to a file.
+ * Returns FALSE in the event of failure.
+ */
+boolean start_trace _((const char *name));
+
+/* the time now, to give trace_span as the start of a span; 0 if not tracing */
+double trace_time _((void));
+
+/* add a span, from the time started until now, to the trace.  The span is
+ * shown against the process given, or ours if it's 0, and the detail given,
+ * if any, is shown as its argument.
+ */
+void trace_span _((const char *name, const char *category,
+		   const char *arg_name, const char *detail,
+		   double started, int pid));
+
+/* finish the trace, at the end of the run */
+void end_trace _((void));
+
+#endif
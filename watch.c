@@ -0,0 +1,420 @@
+/* $Id$
+ *
+ * Watch the input files, and the files the preprocessor read for them, and
+ * run again whenever any of them changes.
+ *
+ * Each run is done by a process forked for it, using a manifest, so the
+ * pages of the inputs that haven't changed are read back from there rather
+ * than parsed again.  As it finishes, the run sends back the names of the
+ * files to watch for the next.  Where inotify is available, we wait on the
+ * directories they're in; otherwise we look at them every so often.  Either
+ * way, we wait until things have been quiet for a moment before running
+ * again, so a burst of saves only causes one run.
+ */
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "c2man.h"
+#include "symbol.h"
+#include "serial.h"
+#include "strconcat.h"
+#include "watch.h"
+
+#ifdef HAS_FORK
+#include <sys/wait.h>
+#ifdef I_SYS_INOTIFY
+#include <sys/inotify.h>
+#include <sys/select.h>
+#endif
+
+/* how long things must be quiet, in milliseconds, before we run again */
+#define SETTLE_TIME	200
+
+/* how often to look at the files without inotify, in seconds */
+#define POLL_TIME	1
+
+/* a file being watched, and how it was when we last looked */
+typedef struct WatchedFile
+{
+    char *name;		/* as given, with ./ in front if there's no / */
+    boolean exists;
+    long mtime;
+    long size;
+} WatchedFile;
+
+static WatchedFile *files = NULL;
+static int num_files = 0, max_files = 0;
+static SymbolTable *file_table = NULL;
+
+/* while a run's list is read, the files watched for it, sorted by name, as
+ * they were just before it started, and when that was.
+ */
+static WatchedFile *old_files = NULL;
+static int num_old_files = 0;
+static long run_started;
+
+/* in a run, where the names of the files to watch go */
+static FILE *watch_list = NULL;
+
+void watch_file(name)
+const char *name;
+{
+    if (watch_list)
+	write_string(watch_list, name);
+}
+
+/* the time now, in seconds */
+static double time_now()
+{
+#if defined(HAS_GETTIMEOFDAY) && defined(I_SYS_TIME)
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+#else
+    return (double)time((time_t *)NULL);
+#endif
+}
+
+/* look at a file, returning TRUE if it's changed since last time */
+static boolean look_at(file)
+WatchedFile *file;
+{
+    struct stat statbuf;
+    boolean exists = stat(file->name, &statbuf) == 0;
+    boolean changed = exists != file->exists ||
+	(exists && ((long)statbuf.st_mtime != file->mtime ||
+		    (long)statbuf.st_size != file->size));
+
+    file->exists = exists;
+    if (exists)
+    {
+	file->mtime = (long)statbuf.st_mtime;
+	file->size = (long)statbuf.st_size;
+    }
+    return changed;
+}
+
+static int compare_files(a, b)
+const void *a, *b;
+{
+    return strcmp(((WatchedFile *)a)->name, ((WatchedFile *)b)->name);
+}
+
+static void add_file(name)
+const char *name;
+{
+    WatchedFile *old = NULL, *file;
+    char *key;
+
+    /* skip the likes of <built-in> */
+    if (*name == '\0' || *name == '<')
+	return;
+
+    key = strchr(name, '/') ? strduplicate(name)
+			    : strconcat("./", name, NULLCP);
+
+    if (file_table == NULL)
+	file_table = create_symbol_table();
+    else if (find_symbol(file_table, key))
+    {
+	free(key);
+	return;
+    }
+    new_symbol(file_table, key, 0);
+
+    if (num_files == max_files)
+    {
+	max_files = max_files ? max_files * 2 : 64;
+	if (files == NULL)
+	    files = (WatchedFile *)safe_malloc(max_files * sizeof *files);
+	else if ((files = (WatchedFile *)realloc(files,
+				    max_files * sizeof *files)) == NULL)
+	    outmem();
+    }
+    file = &files[num_files++];
+
+    if (num_old_files > 0)
+    {
+	WatchedFile wanted;
+
+	wanted.name = key;
+	old = (WatchedFile *)bsearch((char *)&wanted, (char *)old_files,
+				num_old_files, sizeof *old_files, compare_files);
+    }
+
+    /* compare it with how it was before the run, so we see it if it was
+     * changed while the run was going.  one we didn't know of then counts as
+     * changed if it was written since the run started.
+     */
+    if (old)
+	*file = *old;
+    file->name = key;
+    if (!old)
+    {
+	file->exists = FALSE;
+	look_at(file);
+	if (file->exists && file->mtime >= run_started)
+	    file->exists = FALSE;
+    }
+}
+
+/* start a new list of files to watch, keeping the old one to look things up
+ * in until forget_old_files is called.
+ */
+static void start_files()
+{
+    if (num_files > 1)
+	qsort((char *)files, num_files, sizeof *files, compare_files);
+    old_files = files;
+    num_old_files = num_files;
+
+    files = NULL;
+    num_files = max_files = 0;
+    if (file_table)
+    {
+	destroy_symbol_table(file_table);
+	file_table = NULL;
+    }
+}
+
+static void forget_old_files()
+{
+    int i;
+
+    for (i = 0; i < num_old_files; i++)
+	free(old_files[i].name);
+    num_old_files = 0;
+    if (old_files)
+    {
+	free(old_files);
+	old_files = NULL;
+    }
+}
+
+/* look at all the files, returning TRUE if any have changed */
+static boolean any_changed()
+{
+    boolean changed = FALSE;
+    int i;
+
+    for (i = 0; i < num_files; i++)
+	if (look_at(&files[i]))
+	    changed = TRUE;
+    return changed;
+}
+
+/* wait for a file to change by looking at them all every so often.
+ * returns the time the change was seen.
+ */
+static double poll_for_change()
+{
+    double changed_at;
+
+    while (!any_changed())
+	sleep(POLL_TIME);
+    changed_at = time_now();
+
+    /* wait for the rest of the changes to be made */
+    do
+	sleep(POLL_TIME);
+    while (any_changed());
+
+    return changed_at;
+}
+
+#ifdef I_SYS_INOTIFY
+/* wait for a file to change using inotify, on the directories the files are
+ * in, so we see those replaced by renaming a new one over them.
+ * returns the time the change was seen, or -1 if inotify can't be used.
+ */
+static double notify_of_change()
+{
+    SymbolTable *dir_table = create_symbol_table();
+    char **dirs = (char **)safe_malloc(num_files * sizeof *dirs);
+    int *wds = (int *)safe_malloc(num_files * sizeof *wds);
+    int fd, num_dirs = 0, i;
+    char buf[4096];
+    double changed_at = -1;
+    boolean changed = FALSE;
+    ssize_t len;
+
+    if ((fd = inotify_init()) == -1)
+	goto done;
+
+    for (i = 0; i < num_files; i++)
+    {
+	char *dir = strduplicate(files[i].name);
+
+	*strrchr(dir, '/') = '\0';
+	if (*dir == '\0' || find_symbol(dir_table, dir))
+	{
+	    free(dir);
+	    continue;
+	}
+	new_symbol(dir_table, dir, 0);
+
+	if ((wds[num_dirs] = inotify_add_watch(fd, dir,
+			IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE |
+			IN_MOVED_FROM | IN_ATTRIB)) != -1)
+	    dirs[num_dirs++] = dir;
+	else
+	    free(dir);
+    }
+
+    if (num_dirs == 0)
+	goto done;
+
+    for (;;)
+    {
+	fd_set readfds;
+	struct timeval timeout;
+	char *p;
+
+	/* once something has changed, wait for it all to settle */
+	if (changed)
+	{
+	    FD_ZERO(&readfds);
+	    FD_SET(fd, &readfds);
+	    timeout.tv_sec = SETTLE_TIME / 1000;
+	    timeout.tv_usec = (SETTLE_TIME % 1000) * 1000;
+	    if (select(fd + 1, &readfds, NULL, NULL, &timeout) == 0)
+		break;
+	}
+
+	if ((len = read(fd, buf, sizeof buf)) <= 0)
+	{
+	    if (len == -1 && errno == EINTR)
+		continue;
+	    break;
+	}
+
+	for (p = buf; p < buf + len;
+		    p += sizeof(struct inotify_event) +
+					((struct inotify_event *)p)->len)
+	{
+	    struct inotify_event *event = (struct inotify_event *)p;
+	    char *name;
+
+	    if (changed || event->len == 0)
+		continue;
+
+	    for (i = 0; i < num_dirs && wds[i] != event->wd; i++)
+		;
+	    if (i == num_dirs)
+		continue;
+
+	    name = strconcat(dirs[i], "/", event->name, NULLCP);
+	    if (find_symbol(file_table, name))
+	    {
+		changed = TRUE;
+		changed_at = time_now();
+	    }
+	    free(name);
+	}
+    }
+
+done:
+    if (fd != -1)	close(fd);
+    for (i = 0; i < num_dirs; i++)
+	free(dirs[i]);
+    free(dirs);
+    free(wds);
+    destroy_symbol_table(dir_table);
+
+    /* bring what we know of the files up to date */
+    if (changed)
+	any_changed();
+    return changed_at;
+}
+#endif
+
+boolean start_watching(names, num)
+char **names;
+int num;
+{
+    double started = time_now(), changed_at;
+    int fds[2], status, i;
+    char *name;
+    pid_t pid;
+    FILE *f;
+
+    for (;;)
+    {
+	if (pipe(fds) == -1)
+	{
+	    my_perror("can't create pipe to watch", names[0]);
+	    return FALSE;
+	}
+
+	/* see how the files are before the run reads them */
+	any_changed();
+	run_started = (long)time((time_t *)NULL);
+
+	if ((pid = fork()) == 0)
+	{
+	    close(fds[0]);
+	    if ((watch_list = fdopen(fds[1], "w")) == NULL)
+		outmem();
+	    return TRUE;
+	}
+	close(fds[1]);
+
+	if (pid == -1)
+	{
+	    my_perror("can't fork to run", names[0]);
+	    close(fds[0]);
+	    return FALSE;
+	}
+
+	/* the inputs are always watched, even if the run failed */
+	start_files();
+	for (i = 0; i < num; i++)
+	    add_file(names[i]);
+
+	if ((f = fdopen(fds[0], "r")) == NULL)
+	    outmem();
+	while (read_string(f, &name) && name)
+	{
+	    add_file(name);
+	    free(name);
+	}
+	fclose(f);
+	forget_old_files();
+
+	if (waitpid(pid, &status, 0) == -1)
+	    status = -1;
+
+	fprintf(stderr, "%s: %s in %.2f seconds, watching %d files\n",
+	    progname, status == 0 ? "done" : "failed", time_now() - started,
+								num_files);
+
+	/* don't miss anything changed while that was running */
+	if (any_changed())
+	    changed_at = time_now();
+	else
+	{
+#ifdef I_SYS_INOTIFY
+	    if ((changed_at = notify_of_change()) < 0)
+#endif
+		changed_at = poll_for_change();
+	}
+
+	started = changed_at;
+    }
+}
+#else
+boolean start_watching(names, num)
+char **names;
+int num;
+{
+    fprintf(stderr, "%s: can't watch for changes on this system\n",
+								    progname);
+    return FALSE;
+}
+
+void watch_file(name)
+const char *name;
+{
+}
+#endif /* HAS_FORK */
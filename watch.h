@@ -0,0 +1,18 @@
+/* $Id$
+ * run again whenever an input file, or a file read for one, changes
+ */
+#ifndef WATCH_H
+#define WATCH_H
+
+#include "c2man.h"
+
+/* start watching the input files given.  Each run is done by a process
+ * forked for it, for which this returns TRUE; otherwise it only returns, with
+ * FALSE, in the event of failure.
+ */
+boolean start_watching _((char **names, int num));
+
+/* in a run, note a file to watch for the next */
+void watch_file _((const char *name));
+
+#endif